@@ -144,6 +144,63 @@ static char *prefix[3]={ "error", "fatal error", "warning" };
   return 0;
 }
 
+/* Compiling from memory
+ * pc_compilememory() sets a context for the current thread; while it is set,
+ * the source files are looked up in the list of sources that the caller
+ * passed in, and then through the resolver callback of the caller. The binary
+ * file is built in a memory block, and copied into the buffer of the caller
+ * at the end.
+ */
+typedef struct tagMEMCONTEXT {
+  const PC_SOURCE *sources;
+  int numsources;
+  PC_RESOLVER resolver;
+  void *userdata;
+  unsigned char *image;         /* binary file */
+  long imagesize,imagetop,imagepos;
+  int imagedone;                /* binary file was closed without errors */
+} MEMCONTEXT;
+
+SC_VSTATIC MEMCONTEXT *memcontext=NULL;
+
+/* A source file is read in memory completely; a position in the file is then
+ * just an offset.
+ */
+typedef struct tagSRCFILE {
+  const char *text;
+  long length,pos;
+  int eof;
+  char *buffer;                 /* text allocated for a file read from disk */
+  FILE *fp;                     /* file created for writing */
+} SRCFILE;
+
+static SRCFILE *new_srcfile(const char *text,long length)
+{
+  SRCFILE *src=(SRCFILE*)malloc(sizeof(SRCFILE));
+  if (src!=NULL) {
+    memset(src,0,sizeof(SRCFILE));
+    src->text=text;
+    src->length=(length<0) ? (long)strlen(text) : length;
+  } /* if */
+  return src;
+}
+
+static SRCFILE *open_memory(const char *filename)
+{
+  MEMCONTEXT *ctx=memcontext;
+  const char *text;
+  long length;
+  int idx;
+
+  assert(ctx!=NULL);
+  for (idx=0; idx<ctx->numsources; idx++)
+    if (strcmp(ctx->sources[idx].name,filename)==0)
+      return new_srcfile(ctx->sources[idx].text,ctx->sources[idx].length);
+  if (ctx->resolver!=NULL && ctx->resolver(ctx->userdata,filename,&text,&length) && text!=NULL)
+    return new_srcfile(text,length);
+  return NULL;
+}
+
 /* pc_opensrc()
  * Opens a source file (or include file) for reading. The "file" does not have
  * to be a physical file, one might compile from memory.
@@ -158,7 +215,33 @@ static char *prefix[3]={ "error", "fatal error", "warning" };
  */
 void *pc_opensrc(char *filename)
 {
-  return fopen(filename,"rt");
+  SRCFILE *src;
+  FILE *fp;
+  long size,count;
+  char *buffer;
+
+  if (memcontext!=NULL) {
+    if ((src=open_memory(filename))!=NULL || memcontext->resolver!=NULL)
+      return src;       /* with a resolver, the compiler does not access the disk */
+  } /* if */
+
+  if ((fp=fopen(filename,"rt"))==NULL)
+    return NULL;
+  /* in text mode, the number of bytes read may be less than the file size */
+  size=(fseek(fp,0,SEEK_END)==0) ? ftell(fp) : -1;
+  fseek(fp,0,SEEK_SET);
+  if (size<0 || (buffer=(char*)malloc(size+1))==NULL) {
+    fclose(fp);
+    return NULL;
+  } /* if */
+  count=(long)fread(buffer,1,size,fp);
+  fclose(fp);
+  buffer[count]='\0';
+  if ((src=new_srcfile(buffer,count))==NULL)
+    free(buffer);
+  else
+    src->buffer=buffer;
+  return src;
 }
 
 /* pc_createsrc()
@@ -175,7 +258,17 @@ void *pc_opensrc(char *filename)
  */
 void *pc_createsrc(char *filename)
 {
-  return fopen(filename,"wt");
+  SRCFILE *src;
+
+  if (memcontext!=NULL)
+    return NULL;        /* no files are written when compiling from memory */
+  if ((src=new_srcfile("",0))==NULL)
+    return NULL;
+  if ((src->fp=fopen(filename,"wt"))==NULL) {
+    free(src);
+    return NULL;
+  } /* if */
+  return src;
 }
 
 /* pc_closesrc()
@@ -184,8 +277,14 @@ void *pc_createsrc(char *filename)
  */
 void pc_closesrc(void *handle)
 {
-  assert(handle!=NULL);
-  fclose((FILE*)handle);
+  SRCFILE *src=(SRCFILE*)handle;
+
+  assert(src!=NULL);
+  if (src->fp!=NULL)
+    fclose(src->fp);
+  if (src->buffer!=NULL)
+    free(src->buffer);
+  free(src);
 }
 
 /* pc_readsrc()
@@ -194,7 +293,28 @@ void pc_closesrc(void *handle)
  */
 char *pc_readsrc(void *handle,unsigned char *target,int maxchars)
 {
-  return fgets((char*)target,maxchars,(FILE*)handle);
+  SRCFILE *src=(SRCFILE*)handle;
+  const char *start,*ptr,*end;
+  long count;
+
+  assert(src!=NULL);
+  assert(maxchars>1);
+  if (src->pos>=src->length) {
+    src->eof=TRUE;
+    return NULL;
+  } /* if */
+  start=src->text+src->pos;
+  end=src->text+src->length;
+  if (end-start>maxchars-1)
+    end=start+maxchars-1;
+  ptr=(const char*)memchr(start,'\n',end-start);
+  count= (ptr!=NULL) ? (long)(ptr-start)+1 : (long)(end-start);
+  memcpy(target,start,count);
+  target[count]='\0';
+  src->pos+=count;
+  if (ptr==NULL && src->pos>=src->length)
+    src->eof=TRUE;      /* the last line has no '\n' */
+  return (char*)target;
 }
 
 /* pc_writesrc()
@@ -203,12 +323,15 @@ char *pc_readsrc(void *handle,unsigned char *target,int maxchars)
  */
 int pc_writesrc(void *handle,const unsigned char *source)
 {
-  return fputs((char*)source,(FILE*)handle) >= 0;
+  SRCFILE *src=(SRCFILE*)handle;
+
+  assert(src!=NULL && src->fp!=NULL);
+  return fputs((char*)source,src->fp) >= 0;
 }
 
 #define MAXPOSITIONS  4
-static fpos_t srcpositions[MAXPOSITIONS];
-static unsigned char srcposalloc[MAXPOSITIONS];
+SC_VSTATIC long srcpositions[MAXPOSITIONS];
+SC_VSTATIC unsigned char srcposalloc[MAXPOSITIONS];
 
 void pc_clearpossrc(void)
 {
@@ -230,9 +353,9 @@ void *pc_getpossrc(void *handle,void *position)
     srcposalloc[i]=1;
   } else {
     /* use the gived slot */
-    assert((fpos_t*)position>=srcpositions && (fpos_t*)position<srcpositions+sizeof(srcpositions));
+    assert((long*)position>=srcpositions && (long*)position<srcpositions+MAXPOSITIONS);
   } /* if */
-  fgetpos((FILE*)handle,(fpos_t*)position);
+  *(long*)position=((SRCFILE*)handle)->pos;
   return position;
 }
 
@@ -242,15 +365,18 @@ void *pc_getpossrc(void *handle,void *position)
  */
 void pc_resetsrc(void *handle,void *position)
 {
-  assert(handle!=NULL);
+  SRCFILE *src=(SRCFILE*)handle;
+
+  assert(src!=NULL);
   assert(position!=NULL);
-  fsetpos((FILE*)handle,(fpos_t*)position);
+  src->pos=*(long*)position;
+  src->eof=FALSE;
   /* note: the item is not cleared from the pool */
 }
 
 int pc_eofsrc(void *handle)
 {
-  return feof((FILE*)handle);
+  return ((SRCFILE*)handle)->eof;
 }
 
 /* should return a pointer, which is used as a "magic cookie" to all I/O
@@ -315,11 +441,21 @@ char *pc_readasm(void *handle, char *string, int maxchars)
  */
 void *pc_openbin(char *filename)
 {
+  if (memcontext!=NULL) {
+    memcontext->imagetop=memcontext->imagepos=0;
+    memcontext->imagedone=FALSE;
+    return memcontext;
+  } /* if */
   return fopen(filename,"wb");
 }
 
 void pc_closebin(void *handle,int deletefile)
 {
+  if (memcontext!=NULL) {
+    assert(handle==memcontext);
+    memcontext->imagedone=!deletefile;
+    return;
+  } /* if */
   fclose((FILE*)handle);
   if (deletefile)
     remove(binfname);
@@ -331,16 +467,104 @@ void pc_closebin(void *handle,int deletefile)
  */
 void pc_resetbin(void *handle,long offset)
 {
+  if (memcontext!=NULL) {
+    memcontext->imagepos=offset;
+    return;
+  } /* if */
   fflush((FILE*)handle);
   fseek((FILE*)handle,offset,SEEK_SET);
 }
 
 int pc_writebin(void *handle,const void *buffer,int size)
 {
-  return (int)fwrite(buffer,1,size,(FILE*)handle) == size;
+  MEMCONTEXT *ctx=memcontext;
+
+  if (ctx==NULL)
+    return (int)fwrite(buffer,1,size,(FILE*)handle) == size;
+  if (ctx->imagepos+size>ctx->imagesize) {
+    long newsize=2*ctx->imagesize+size+4096;
+    unsigned char *image=(unsigned char*)realloc(ctx->image,newsize);
+    if (image==NULL)
+      return FALSE;
+    ctx->image=image;
+    ctx->imagesize=newsize;
+  } /* if */
+  if (ctx->imagepos>ctx->imagetop)
+    memset(ctx->image+ctx->imagetop,0,ctx->imagepos-ctx->imagetop);
+  memcpy(ctx->image+ctx->imagepos,buffer,size);
+  ctx->imagepos+=size;
+  if (ctx->imagepos>ctx->imagetop)
+    ctx->imagetop=ctx->imagepos;
+  return TRUE;
 }
 
 long pc_lengthbin(void *handle)
 {
+  if (memcontext!=NULL)
+    return memcontext->imagepos;
   return ftell((FILE*)handle);
 }
+
+/* pc_compilememory()
+ * Compiles the sources in memory and stores the binary file in a buffer of
+ * the caller.
+ *    argc, argv  the options (argv[0] is the path of the compiler); the names
+ *                of the sources are appended to these
+ *    sources     the source files; they are compiled as one program, like
+ *                several source files on the command line
+ *    resolver    a function that is called for every file that the compiler
+ *                tries to open (include files and the prefix file), except
+ *                for those in "sources"; it returns 0 if the file does not
+ *                exist, and otherwise sets the pointer to the text of the
+ *                file (and the length, or -1 for a zero-terminated string);
+ *                the text must remain valid until pc_compilememory()
+ *                returns; if "resolver" is NULL, the compiler reads the
+ *                other files from disk
+ *    amx         the buffer for the binary file
+ *    amxsize     on input, the size of the "amx" buffer; on output, the
+ *                size of the binary file (or 0 if the compile failed)
+ * Return:
+ *    The return code of pc_compile(), or -1 if the binary file does not fit
+ *    in the buffer ("amxsize" then holds the required size).
+ * Note:
+ *    Several threads may call this function at the same time, if the library
+ *    is built with PAWNC_REENTRANT.
+ */
+int pc_compilememory(int argc,char **argv,const PC_SOURCE *sources,int numsources,
+                     PC_RESOLVER resolver,void *userdata,void *amx,long *amxsize)
+{
+  MEMCONTEXT ctx;
+  char **args;
+  int idx,retcode;
+
+  assert(amxsize!=NULL);
+  if ((args=(char**)malloc((argc+numsources+1)*sizeof(char*)))==NULL)
+    return 2;
+  for (idx=0; idx<argc; idx++)
+    args[idx]=argv[idx];
+  for (idx=0; idx<numsources; idx++)
+    args[argc+idx]=(char*)sources[idx].name;
+  args[argc+numsources]=NULL;
+
+  memset(&ctx,0,sizeof ctx);
+  ctx.sources=sources;
+  ctx.numsources=numsources;
+  ctx.resolver=resolver;
+  ctx.userdata=userdata;
+  memcontext=&ctx;
+  retcode=pc_compile(argc+numsources,args);
+  memcontext=NULL;
+
+  if (!ctx.imagedone || retcode!=0) {
+    *amxsize=0;
+  } else if (ctx.imagetop>*amxsize) {
+    *amxsize=ctx.imagetop;
+    retcode=-1;
+  } else {
+    memcpy(amx,ctx.image,ctx.imagetop);
+    *amxsize=ctx.imagetop;
+  } /* if */
+  free(ctx.image);
+  free(args);
+  return retcode;
+}
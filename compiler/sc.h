@@ -54,6 +54,10 @@
 #define sDIMEN_MAX    3     /* maximum number of array dimensions */
 #define sLINEMAX      1023  /* input line length (in characters) */
 #define sCOMP_STACK   32    /* maximum nesting of #if .. #endif sections */
+#define sGLBHASH      4096  /* number of buckets in the global symbol table index (power of 2) */
+#define sLOCHASH      256   /* number of buckets in the local symbol table index (power of 2) */
+#define sPATHHASH     256   /* number of buckets in the include file resolution cache (power of 2) */
+#define sSUBSTHASH    1024  /* number of buckets in the text substitution table (power of 2) */
 #define sDEF_LITMAX   500   /* initial size of the literal pool, in "cells" */
 #define sDEF_AMXSTACK 4096  /* default stack size for AMX files */
 #define PREPROC_TERM  '\x7f'/* termination character for preprocessor expressions (the "DEL" code) */
@@ -121,6 +125,9 @@ typedef struct s_statelist {
 typedef struct s_symbol {
   struct s_symbol *next;
   struct s_symbol *parent;  /* hierarchical types (multi-dimensional arrays) */
+  struct s_symbol *child;   /* first sub-symbol, see setparent() */
+  struct s_symbol *sibling; /* next sub-symbol with the same parent */
+  struct s_symbol *hnext;   /* next symbol in the same hash bucket */
 
   char name[sNAMEMAX+1];
   uint32_t hash;        /* value derived from name, for quicker searching */
@@ -164,6 +171,10 @@ typedef struct s_symbol {
 
   struct s_symbol **refer;  /* referrer list, functions that "use" this symbol */
   int numrefers;        /* number of entries in the referrer list */
+  int refcount;         /* number of referrers (non-NULL entries) in the list */
+  struct s_symbol **referto;/* reverse edges: symbols that this function "uses" */
+  int numreferto;       /* number of entries in the "referto" list */
+  int maxreferto;       /* allocated size of the "referto" list */
 
   char *documentation;  /* optional documentation string */
 } symbol;
@@ -497,6 +508,16 @@ DLLEXPORT int pc_addconstant(const char *name,cell value,int tag);
 DLLEXPORT int pc_addtag(const char *name);
 DLLEXPORT int pc_enablewarning(int number,int enable);
 
+/* compiling from memory (see LIBPAWNC.C) */
+typedef struct tagPC_SOURCE {
+  const char *name;     /* name of the source file, e.g. for error messages */
+  const char *text;     /* contents of the file */
+  long length;          /* length of "text", or -1 for a zero-terminated string */
+} PC_SOURCE;
+typedef int (*PC_RESOLVER)(void *userdata,const char *name,const char **text,long *length);
+DLLEXPORT int pc_compilememory(int argc,char **argv,const PC_SOURCE *sources,int numsources,
+                               PC_RESOLVER resolver,void *userdata,void *amx,long *amxsize);
+
 /*
  * Functions called from the compiler (to be implemented by you)
  */
@@ -537,6 +558,23 @@ long pc_lengthbin(void *handle); /* return the length of the file */
 #endif
 
 
+/* with PAWNC_REENTRANT, every thread has its own copy of the compiler state
+ * (the global variables and the static variables in the compiler files), so
+ * that a host application can run several compiles at the same time, each in
+ * its own thread
+ */
+#if defined PAWNC_REENTRANT
+  #if defined _MSC_VER || defined __BORLANDC__ || defined __WATCOMC__
+    #define SC_VTLS   __declspec(thread)
+  #elif defined __GNUC__ || defined __clang__
+    #define SC_VTLS   __thread
+  #else
+    #define SC_VTLS   _Thread_local
+  #endif
+#else
+  #define SC_VTLS
+#endif
+
 /* by default, functions and variables used in throughout the compiler
  * files are "external"
  */
@@ -544,10 +582,13 @@ long pc_lengthbin(void *handle); /* return the length of the file */
   #define SC_FUNC
 #endif
 #if !defined SC_VDECL
-  #define SC_VDECL  extern
+  #define SC_VDECL  extern SC_VTLS
 #endif
 #if !defined SC_VDEFINE
-  #define SC_VDEFINE
+  #define SC_VDEFINE SC_VTLS
+#endif
+#if !defined SC_VSTATIC
+  #define SC_VSTATIC static SC_VTLS
 #endif
 
 /* function prototypes in SC1.C */
@@ -573,6 +614,8 @@ SC_FUNC stkitem popstk(void);
 SC_FUNC void clearstk(void);
 SC_FUNC int plungequalifiedfile(char *name);  /* explicit path included */
 SC_FUNC int plungefile(char *name,int try_currentpath,int try_includepaths);   /* search through "include" paths */
+SC_FUNC void watchfile(char *name,int try_currentpath,int try_includepaths);    /* add search paths to the dependencies */
+SC_FUNC void delete_pathcache(void);
 SC_FUNC char *strdel(char *str,size_t len);
 SC_FUNC char *strins(char *dest,char *src,size_t srclen);
 SC_FUNC void preprocess(void);
@@ -593,13 +636,19 @@ SC_FUNC int alphanum(unsigned char c);
 SC_FUNC int ishex(char c);
 SC_FUNC void delete_symbol(symbol *root,symbol *sym);
 SC_FUNC void delete_symbols(symbol *root,int level,int del_labels,int delete_functions);
+SC_FUNC void delete_symbolpool(void);
 SC_FUNC int refer_symbol(symbol *entry,symbol *bywhom);
+SC_FUNC int unrefer_symbol(symbol *entry,symbol *bywhom);
+SC_FUNC int is_referrer(const symbol *entry,const symbol *bywhom);
+SC_FUNC void delete_refertable(void);
 SC_FUNC void markusage(symbol *sym,int usage);
 SC_FUNC uint32_t namehash(const char *name);
+SC_FUNC void rename_symbol(symbol *sym,const char *newname);
 SC_FUNC symbol *findglb(const char *name,int filter);
 SC_FUNC symbol *findloc(const char *name);
 SC_FUNC symbol *findconst(const char *name,int *matchtag);
 SC_FUNC symbol *finddepend(const symbol *parent);
+SC_FUNC void setparent(symbol *sym,symbol *parent);
 SC_FUNC symbol *addsym(const char *name,cell addr,int ident,int vclass,int tag,
                        int usage);
 SC_FUNC symbol *addvariable(const char *name,cell addr,int ident,int vclass,int tag,
@@ -741,7 +790,7 @@ SC_FUNC stringlist *insert_path(char *path);
 SC_FUNC char *get_path(int index);
 SC_FUNC void delete_pathtable(void);
 SC_FUNC stringpair *insert_subst(char *pattern,char *substitution,int prefixlen);
-SC_FUNC int get_subst(int index,char **pattern,char **substitution);
+SC_FUNC stringpair *get_substbucket(int index);
 SC_FUNC stringpair *find_subst(char *name,int length);
 SC_FUNC int delete_subst(char *name,int length);
 SC_FUNC void delete_substtable(void);
@@ -751,6 +800,9 @@ SC_FUNC void delete_sourcefiletable(void);
 SC_FUNC stringlist *insert_inputfile(char *string);
 SC_FUNC char *get_inputfile(int index);
 SC_FUNC void delete_inputfiletable(void);
+SC_FUNC stringlist *insert_dependency(const char *filename);
+SC_FUNC char *get_dependency(int index);
+SC_FUNC void delete_dependencytable(void);
 SC_FUNC stringlist *insert_docstring(char *string,int append);
 SC_FUNC char *get_docstring(int index);
 SC_FUNC void delete_docstring(int index);
@@ -789,6 +841,30 @@ SC_FUNC int cp_set(const char *name);
 SC_FUNC cell cp_translate(const unsigned char *string,const unsigned char **endptr);
 SC_FUNC cell get_utf8_char(const unsigned char *string,const unsigned char **endptr);
 SC_FUNC int scan_utf8(FILE *fp,const char *filename);
+SC_FUNC void delete_utf8cache(void);
+
+/* function prototypes in SCCACHE.C */
+SC_FUNC int cache_start(const char *directory);
+SC_FUNC void cache_keydata(const void *data,size_t size);
+SC_FUNC void cache_keystring(const char *string);
+SC_FUNC int cache_keyfile(const char *filename);
+SC_FUNC int cache_fetch(const char *target);
+SC_FUNC int cache_store(const char *target);
+SC_FUNC FILE *tempfile_open(char *path,size_t size,const char *base);
+SC_FUNC int tempfile_commit(const char *tmpname,const char *path);
+
+/* function prototypes in SCPCH.C */
+SC_FUNC void pch_startrecord(int start);
+SC_FUNC int pch_recording(void);
+SC_FUNC void pch_filepush(const char *name);
+SC_FUNC void pch_filepop(const char *name);
+SC_FUNC void pch_filewatch(const char *name);
+SC_FUNC int pch_create(void);
+SC_FUNC int pch_save(const char *filename);
+SC_FUNC int pch_load(const char *filename,const char *prefixname);
+SC_FUNC int pch_failed(void);
+SC_FUNC void pch_apply(void);
+SC_FUNC void pch_delete(void);
 
 /* function prototypes in SCSTATE.C */
 SC_FUNC constvalue *automaton_add(const char *name);
@@ -842,6 +918,7 @@ SC_VDECL int sc_debug;        /* debug/optimization options (bit field) */
 SC_VDECL int sc_packstr;      /* strings are packed by default? */
 SC_VDECL int sc_asmfile;      /* create .ASM file? */
 SC_VDECL int sc_listing;      /* create .LST file? */
+SC_VDECL int sc_expandonly;   /* preprocess only, do not parse (implies sc_listing) */
 SC_VDECL int pc_compress;     /* compress bytecode? */
 SC_VDECL int sc_needsemicolon;/* semicolon required to terminate expressions? */
 SC_VDECL int sc_dataalign;    /* data alignment value */
@@ -855,6 +932,7 @@ SC_VDECL int freading;        /* is there an input file ready for reading? */
 SC_VDECL int fline;           /* the line number in the current file */
 SC_VDECL short fnumber;       /* number of files in the input file table */
 SC_VDECL short fcurrent;      /* current file being processed */
+SC_VDECL short fscope;        /* file number for the scope of "static" symbols */
 SC_VDECL short sc_intest;     /* true if inside a test */
 SC_VDECL int pc_sideeffect;   /* true if an expression causes a side-effect */
 SC_VDECL int pc_stmtindent;   /* current indent of the statement */
@@ -879,6 +957,7 @@ SC_VDECL constvalue sc_state_tab;     /* state table */
 
 SC_VDECL FILE *inpf;          /* file read from (source or include) */
 SC_VDECL FILE *inpf_org;      /* main source file */
+SC_VDECL int inpf_index;      /* index of the main source file being read */
 SC_VDECL FILE *outf;          /* file written to */
 
 SC_VDECL jmp_buf errbuf;      /* target of longjmp() on a fatal error */
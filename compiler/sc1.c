@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #if defined	__WIN32__ || defined _WIN32 || defined __MSDOS__
   #include <conio.h>
@@ -55,6 +56,22 @@
 #if defined __WIN32__ || defined _WIN32 || defined _Windows
   #include <windows.h>
 #endif
+#if (defined __LINUX__ || defined __GNUC__) && !defined NO_MAIN
+  #include <sys/time.h>         /* for gettimeofday() */
+  #include <unistd.h>           /* for sysconf() */
+#endif
+#if defined PAWNC_REENTRANT && !defined NO_MAIN \
+    && !(defined __WIN32__ || defined _WIN32 || defined _Windows)
+  #include <pthread.h>
+#endif
+#if (defined __unix__ || defined __APPLE__ || defined __LINUX__) && !defined NO_MAIN
+  #define PAWN_SERVER           /* compile server on a local (Unix) socket */
+  #include <errno.h>
+  #include <signal.h>
+  #include <sys/socket.h>
+  #include <sys/stat.h>
+  #include <sys/un.h>
+#endif
 
 #if defined __WIN32__ || defined _WIN32 || defined WIN32 || defined __NT__
   #define DLLEXPORT __declspec (dllexport)
@@ -70,14 +87,20 @@
 
 static void resetglobals(void);
 static void initglobals(void);
+static void restartsource(void);
 static char *get_extension(char *filename);
 static void setopt(int argc,char **argv,char *oname,char *ename,char *pname,
                    char *rname,char *codepage);
+static const char *option_value(const char *optptr);
 static void setconfig(char *root);
 static void setcaption(void);
 static void about(void);
 static void setconstants(void);
 static void plungeprefix(char *prefixname);
+#if !defined PAWN_LIGHT
+  static int prefixpass(char *prefixname);
+  static int cachekey(char *prefixname,char *codepage);
+#endif
 static void parse(void);
 static void dumplits(void);
 static void dumpzero(int count);
@@ -104,9 +127,13 @@ static int declargs(symbol *sym,int chkshadow);
 static void doarg(char *name,int ident,int offset,int tags[],int numtags,
                   int fpublic,int fconst,int chkshadow,arginfo *arg);
 static void make_report(symbol *root,FILE *log,char *sourcefile);
+#if !defined PAWN_LIGHT
+  static void make_depfile(char *target);
+#endif
 static void reduce_referrers(symbol *root);
 static void gen_ovlinfo(symbol *root);
 static long max_stacksize(symbol *root,int *recursion);
+static void report_stacksizes(symbol *root);
 static long max_overlaysize(symbol *root);
 static int testsymbols(symbol *root,int level,int testlabs,int testconst);
 static void destructsymbols(symbol *root,int level);
@@ -135,27 +162,32 @@ static void addwhile(int *ptr);
 static void delwhile(void);
 static int *readwhile(void);
 
-static int lastst     = 0;      /* last executed statement type */
-static int nestlevel  = 0;      /* number of active (open) compound statements */
-static int endlessloop= 0;      /* nesting level of endless loop */
-static int rettype    = 0;      /* the type that a "return" expression should have */
-static int skipinput  = 0;      /* number of lines to skip from the first input file */
-static int optproccall = TRUE;  /* support "procedure call" */
-static int verbosity  = 1;      /* verbosity level, 0=quiet, 1=normal, 2=verbose */
-static int sc_reparse = 0;      /* needs 3th parse because of changed prototypes? */
-static int sc_parsenum = 0;     /* number of the extra parses */
-static int wq[wqTABSZ];         /* "while queue", internal stack for nested loops */
-static int *wqptr;              /* pointer to next entry */
+SC_VSTATIC int lastst     = 0;      /* last executed statement type */
+SC_VSTATIC int nestlevel  = 0;      /* number of active (open) compound statements */
+SC_VSTATIC int endlessloop= 0;      /* nesting level of endless loop */
+SC_VSTATIC int rettype    = 0;      /* the type that a "return" expression should have */
+SC_VSTATIC int skipinput  = 0;      /* number of lines to skip from the first input file */
+SC_VSTATIC int optproccall = TRUE;  /* support "procedure call" */
+SC_VSTATIC int verbosity  = 1;      /* verbosity level, 0=quiet, 1=normal, 2=verbose */
+SC_VSTATIC int sc_reparse = 0;      /* needs 3th parse because of changed prototypes? */
+SC_VSTATIC int sc_parsenum = 0;     /* number of the extra parses */
+SC_VSTATIC int wq[wqTABSZ];         /* "while queue", internal stack for nested loops */
+SC_VSTATIC int *wqptr;              /* pointer to next entry */
 #if !defined PAWN_LIGHT
-  static char sc_rootpath[_MAX_PATH]; /* base path of the installation */
-  static char sc_binpath[_MAX_PATH];  /* path for the binaries, often sc_rootpath + /bin */
-  static char *pc_globaldoc=NULL;/* main documentation */
-  static char *pc_recentdoc=NULL;/* documentation from the most recent comment block */
-  int pc_docstring_suspended=FALSE;
+  SC_VSTATIC char sc_rootpath[_MAX_PATH]; /* base path of the installation */
+  SC_VSTATIC char sc_binpath[_MAX_PATH];  /* path for the binaries, often sc_rootpath + /bin */
+  SC_VSTATIC char *pc_globaldoc=NULL;/* main documentation */
+  SC_VSTATIC char *pc_recentdoc=NULL;/* documentation from the most recent comment block */
+  SC_VSTATIC char pchfname[_MAX_PATH];    /* precompiled prefix file */
+  SC_VSTATIC char depfname[_MAX_PATH];    /* dependency file */
+  SC_VSTATIC char cachedir[_MAX_PATH];    /* directory for cached output files */
+  SC_VSTATIC int sc_makedeps=FALSE;       /* write a dependency file */
+  SC_VDEFINE int pc_docstring_suspended=FALSE;
 #endif
 #if defined	__WIN32__ || defined _WIN32 || defined _Windows
-  static HWND hwndFinish = 0;
+  SC_VSTATIC HWND hwndFinish = 0;
 #endif
+SC_VSTATIC int pc_keepstate=FALSE;  /* keep immutable tables between compiles (batch mode) */
 
 #if !defined NO_MAIN
 
@@ -163,11 +195,877 @@ static int *wqptr;              /* pointer to next entry */
   extern unsigned int _stklen = 0x2000;
 #endif
 
+static void delete_srccache(void);
+static int compilebatch(int argc,char *argv[],int batcharg,int workers);
+static int processors(void);
+#if defined PAWN_SERVER
+  static int compileserver(const char *socketname);
+  static int compileclient(int argc,char *argv[],int clientarg);
+#endif
+
 int main(int argc, char *argv[])
 {
-  return pc_compile(argc,argv);
+  int retcode,arg,batcharg,workers,servearg,clientarg;
+
+  /* option -B<manifest> selects batch mode and option -j<num> sets the number
+   * of compiles that run at the same time; options -Z and -z select the
+   * compile server or pass the compile to a server; these options must be on
+   * the command line (they are not options of a single compile)
+   */
+  batcharg=0;
+  workers=0;
+  servearg=clientarg=0;
+  for (arg=1; arg<argc; arg++) {
+    #if DIRSEP_CHAR=='/'
+      if (argv[arg][0]!='-')
+        continue;
+    #else
+      if (argv[arg][0]!='-' && argv[arg][0]!='/')
+        continue;
+    #endif
+    if (argv[arg][1]=='B')
+      batcharg=arg;
+    else if (argv[arg][1]=='j')
+      workers=(argv[arg][2]!='\0') ? atoi(argv[arg]+2) : processors();
+    else if (argv[arg][1]=='Z')
+      servearg=arg;
+    else if (argv[arg][1]=='z')
+      clientarg=arg;
+  } /* for */
+  retcode=-1;
+  #if defined PAWN_SERVER
+    if (servearg>0)
+      retcode=compileserver(argv[servearg]+2);
+    else if (clientarg>0)
+      retcode=compileclient(argc,argv,clientarg);
+  #else
+    if (servearg>0) {
+      pc_printf("the compile server is not supported on this platform\n");
+      retcode=1;
+    } /* if */
+  #endif
+  if (retcode<0 && clientarg>0) {
+    /* no server, compile locally */
+    for (arg=clientarg; arg<argc-1; arg++)
+      argv[arg]=argv[arg+1];
+    argc--;
+  } /* if */
+  if (retcode>=0)
+    /* nothing, done by the server */;
+  else if (batcharg>0 || workers>0)
+    retcode=compilebatch(argc,argv,batcharg,workers);
+  else
+    retcode=pc_compile(argc,argv);
+  delete_srccache();
+  delete_utf8cache();
+  delete_pathcache();
+  return retcode;
+}
+
+/* processors() returns the number of processors, for option -j without a
+ * count
+ */
+static int processors(void)
+{
+  #if defined __WIN32__ || defined _WIN32 || defined _Windows
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+  #elif defined _SC_NPROCESSORS_ONLN
+    long count=sysconf(_SC_NPROCESSORS_ONLN);
+    return (count>0) ? (int)count : 1;
+  #else
+    return 1;
+  #endif
+}
+
+/* timer_ms() returns a time stamp in milliseconds (wall clock time where
+ * available, because in a parallel build, the processor time of the process
+ * is the sum of all workers)
+ */
+static unsigned long timer_ms(void)
+{
+  #if defined __WIN32__ || defined _WIN32 || defined _Windows
+    return (unsigned long)GetTickCount();
+  #elif defined __LINUX__ || defined __GNUC__
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return (unsigned long)tv.tv_sec*1000uL+(unsigned long)tv.tv_usec/1000;
+  #else
+    return (unsigned long)(clock()*1000/CLOCKS_PER_SEC);
+  #endif
+}
+
+typedef struct s_batchjob {
+  int argc;
+  char **argv;          /* common arguments, followed by those of the job */
+  char *line;           /* the arguments of the job point into this string */
+  char *label;          /* the first source file, for the report */
+  unsigned long group;  /* hash of the names of the files that the job includes */
+  int retcode,errors,warnings;
+  unsigned long time;   /* compile time in milliseconds */
+  char *output;         /* captured output (in a parallel build) */
+  size_t outputsize,outputtop;
+  int done;
+} batchjob;
+
+/* In a parallel build, the output of every job is captured, so that it can be
+ * printed in the order of the jobs, rather than in the order that the workers
+ * finish them. Every message is stored with a prefix byte for the stream
+ * (1=stdout, 2=stderr) and a zero terminator.
+ */
+SC_VSTATIC batchjob *capturejob=NULL;
+
+/* va_copy() is C99; older compilers may have it as __va_copy(), or the
+ * va_list is a plain pointer or array that can be copied
+ */
+#if !defined va_copy
+  #if defined __va_copy
+    #define va_copy(dest,src)   __va_copy(dest,src)
+  #else
+    #define va_copy(dest,src)   memcpy(&(dest),&(src),sizeof(va_list))
+  #endif
+#endif
+
+static int capture_output(int stream,const char *format,va_list argptr)
+{
+  batchjob *job=capturejob;
+  va_list args;
+  int length;
+
+  assert(job!=NULL);
+  va_copy(args,argptr);
+  length=vsnprintf(NULL,0,format,args);
+  va_end(args);
+  if (length<0)
+    return length;
+  if (job->outputtop+length+2>job->outputsize) {
+    size_t size=job->outputsize*2+length+2;
+    char *buffer=(char*)realloc(job->output,size);
+    if (buffer==NULL)
+      return -1;                /* drop the message */
+    job->output=buffer;
+    job->outputsize=size;
+  } /* if */
+  job->output[job->outputtop]=(char)stream;
+  vsnprintf(job->output+job->outputtop+1,length+1,format,argptr);
+  job->outputtop+=length+2;
+  return length;
+}
+
+static int capture_printf(int stream,const char *format,...)
+{
+  va_list argptr;
+  int ret;
+
+  va_start(argptr,format);
+  ret=capture_output(stream,format,argptr);
+  va_end(argptr);
+  return ret;
+}
+
+static void report_job(batchjob *job,int index,int count)
+{
+  size_t pos;
+
+  for (pos=0; pos<job->outputtop; pos+=strlen(job->output+pos+1)+2) {
+    FILE *stream=(job->output[pos]==2) ? stderr : stdout;
+    fputs(job->output+pos+1,stream);
+    fflush(stream);             /* keep the order when both go to the same file */
+  } /* for */
+  pc_printf("[%d/%d] %s: %s (%d error%s, %d warning%s, %lu ms)\n",
+            index+1,count,(job->label!=NULL) ? job->label : "?",
+            (job->retcode==0) ? "ok" : "FAILED",
+            job->errors,(job->errors==1) ? "" : "s",
+            job->warnings,(job->warnings==1) ? "" : "s",job->time);
+}
+
+static void run_job(batchjob *job)
+{
+  unsigned long start=timer_ms();
+  job->retcode=pc_compile(job->argc,job->argv);
+  job->errors=errnum;
+  job->warnings=warnnum;
+  job->time=timer_ms()-start;
+}
+
+/* add_job() splits the line into arguments and adds the job to the list;
+ * arguments with spaces must be between double quotes
+ */
+static int add_job(batchjob **jobs,int *count,int argc,char *argv[],
+                   int batcharg,int workerarg,const char *line)
+{
+  batchjob *job,*list;
+  char *ptr;
+  int arg,num;
+
+  for (ptr=(char*)line; *ptr<=' ' && *ptr!='\0'; ptr++)
+    /* nothing */;
+  if (*ptr=='\0' || *ptr=='#')
+    return TRUE;                /* empty line or comment */
+  if ((list=(batchjob*)realloc(*jobs,(*count+1)*sizeof(batchjob)))==NULL)
+    return FALSE;
+  *jobs=list;
+  job=&list[*count];
+  memset(job,0,sizeof(batchjob));
+  /* every job gets the common arguments, plus at most one argument for every
+   * two characters on the line
+   */
+  num=argc+strlen(ptr)/2+2;
+  if ((job->line=duplicatestring(ptr))==NULL
+      || (job->argv=(char**)malloc(num*sizeof(char*)))==NULL)
+  {
+    free(job->line);
+    return FALSE;
+  } /* if */
+  (*count)++;
+  for (arg=0; arg<argc; arg++)
+    if (arg!=batcharg && arg!=workerarg)
+      job->argv[job->argc++]=argv[arg];
+  ptr=job->line;
+  for ( ;; ) {
+    while (*ptr<=' ' && *ptr!='\0')
+      ptr++;
+    if (*ptr=='\0')
+      break;
+    if (*ptr=='"') {
+      job->argv[job->argc++]=++ptr;
+      while (*ptr!='"' && *ptr!='\0')
+        ptr++;
+    } else {
+      job->argv[job->argc++]=ptr;
+      while (*ptr>' ')
+        ptr++;
+    } /* if */
+    if (*ptr!='\0')
+      *ptr++='\0';
+    if (job->label==NULL && job->argv[job->argc-1][0]!='-')
+      job->label=job->argv[job->argc-1];  /* first source file */
+  } /* for */
+  job->argv[job->argc]=NULL;
+  return TRUE;
+}
+
+/* job_group() returns a hash of the names in the #include and #tryinclude
+ * directives of the source files of a job; jobs that include the same files
+ * go to the same worker, where these files are still in the source cache
+ */
+static unsigned long job_group(batchjob *job)
+{
+  char line[sLINEMAX+1];
+  unsigned long hash=2166136261uL;      /* FNV-1a */
+  unsigned char *ptr;
+  FILE *fp;
+  int arg;
+
+  for (arg=job->argc-1; arg>0 && job->argv[arg]!=job->label; arg--)
+    /* nothing */;
+  for ( ; arg>0 && arg<job->argc; arg++) {
+    if (job->argv[arg][0]=='-' || job->argv[arg][0]=='@')
+      continue;
+    if ((fp=fopen(job->argv[arg],"r"))==NULL)
+      continue;
+    while (fgets(line,sizeof line,fp)!=NULL) {
+      for (ptr=(unsigned char*)line; *ptr<=' ' && *ptr!='\0'; ptr++)
+        /* nothing */;
+      if (*ptr!='#')
+        continue;
+      for (ptr++; *ptr<=' ' && *ptr!='\0'; ptr++)
+        /* nothing */;
+      if (strncmp((char*)ptr,"include",7)!=0 && strncmp((char*)ptr,"tryinclude",10)!=0)
+        continue;
+      for ( ; *ptr!='\0' && *ptr!='\n'; ptr++) {
+        hash^=*ptr;
+        hash*=16777619uL;
+      } /* for */
+    } /* while */
+    fclose(fp);
+  } /* for */
+  return hash & 0xffffffffuL;
 }
 
+#if defined PAWNC_REENTRANT
+  #if defined __WIN32__ || defined _WIN32 || defined _Windows
+    typedef CRITICAL_SECTION batchlock;
+    #define batch_initlock(l)   InitializeCriticalSection(l)
+    #define batch_deletelock(l) DeleteCriticalSection(l)
+    #define batch_lock(l)       EnterCriticalSection(l)
+    #define batch_unlock(l)     LeaveCriticalSection(l)
+    typedef CONDITION_VARIABLE batchsignal;
+    #define batch_initsignal(s) InitializeConditionVariable(s)
+    #define batch_deletesignal(s)
+    #define batch_wait(s,l)     SleepConditionVariableCS(s,l,INFINITE)
+    #define batch_wakeup(s)     WakeAllConditionVariable(s)
+  #else
+    typedef pthread_mutex_t batchlock;
+    #define batch_initlock(l)   pthread_mutex_init(l,NULL)
+    #define batch_deletelock(l) pthread_mutex_destroy(l)
+    #define batch_lock(l)       pthread_mutex_lock(l)
+    #define batch_unlock(l)     pthread_mutex_unlock(l)
+    typedef pthread_cond_t batchsignal;
+    #define batch_initsignal(s) pthread_cond_init(s,NULL)
+    #define batch_deletesignal(s) pthread_cond_destroy(s)
+    #define batch_wait(s,l)     pthread_cond_wait(s,l)
+    #define batch_wakeup(s)     pthread_cond_broadcast(s)
+  #endif
+
+  /* The jobs are sorted on their group; a range of jobs with the same group
+   * is handed out to one worker, job by job. A worker that is done with its
+   * group starts on a group that no other worker has touched, or it helps
+   * with the group that has the most jobs left.
+   */
+  typedef struct s_batchgroup {
+    int next,end;       /* range in the sorted index array */
+    int workers;        /* number of workers on this group */
+  } batchgroup;
+
+  typedef struct s_batchqueue {
+    batchjob *jobs;
+    int *order;         /* job indices, sorted on group */
+    batchgroup *groups;
+    int numgroups;
+    batchlock lock;
+    batchsignal finished;
+  } batchqueue;
+
+  static int compare_jobs(const batchjob *jobs,int idx1,int idx2)
+  {
+    if (jobs[idx1].group!=jobs[idx2].group)
+      return (jobs[idx1].group<jobs[idx2].group) ? -1 : 1;
+    return idx1-idx2;
+  }
+
+  static batchjob *next_job(batchqueue *queue,int *group)
+  {
+    int idx,best;
+
+    batch_lock(&queue->lock);
+    if (*group<0 || queue->groups[*group].next>=queue->groups[*group].end) {
+      if (*group>=0)
+        queue->groups[*group].workers--;
+      best=-1;
+      for (idx=0; idx<queue->numgroups; idx++) {
+        batchgroup *g=&queue->groups[idx];
+        if (g->next>=g->end)
+          continue;
+        if (best<0 || (g->workers==0 && queue->groups[best].workers>0)
+            || (g->workers==queue->groups[best].workers
+                && g->end-g->next>queue->groups[best].end-queue->groups[best].next))
+          best=idx;
+      } /* for */
+      *group=best;
+      if (best>=0)
+        queue->groups[best].workers++;
+    } /* if */
+    idx=(*group>=0) ? queue->order[queue->groups[*group].next++] : -1;
+    batch_unlock(&queue->lock);
+    return (idx>=0) ? &queue->jobs[idx] : NULL;
+  }
+
+  #if defined __WIN32__ || defined _WIN32 || defined _Windows
+    static DWORD WINAPI batch_worker(LPVOID arg)
+  #else
+    static void *batch_worker(void *arg)
+  #endif
+  {
+    batchqueue *queue=(batchqueue*)arg;
+    batchjob *job;
+    int group=-1;
+
+    pc_keepstate=TRUE;          /* every worker has its own tables */
+    while ((job=next_job(queue,&group))!=NULL) {
+      capturejob=job;
+      run_job(job);
+      capturejob=NULL;
+      batch_lock(&queue->lock);
+      job->done=TRUE;
+      batch_wakeup(&queue->finished);
+      batch_unlock(&queue->lock);
+    } /* while */
+    pc_keepstate=FALSE;
+    phopt_cleanup();
+    pch_delete();
+    cp_set(NULL);
+    delete_srccache();
+    delete_utf8cache();
+    delete_pathcache();
+    return 0;
+  }
+
+  /* run_parallel() returns FALSE if the workers cannot be started; in that
+   * case, no job has run
+   */
+  static int run_parallel(batchjob *jobs,int count,int workers)
+  {
+    batchqueue queue;
+    #if defined __WIN32__ || defined _WIN32 || defined _Windows
+      HANDLE *threads;
+    #else
+      pthread_t *threads;
+    #endif
+    int idx,started;
+
+    memset(&queue,0,sizeof queue);
+    queue.jobs=jobs;
+    queue.order=(int*)malloc(count*sizeof(int));
+    queue.groups=(batchgroup*)malloc(count*sizeof(batchgroup));
+    threads=malloc(workers*sizeof(*threads));
+    if (queue.order==NULL || queue.groups==NULL || threads==NULL) {
+      free(queue.order);
+      free(queue.groups);
+      free(threads);
+      return FALSE;
+    } /* if */
+    for (idx=0; idx<count; idx++) {
+      jobs[idx].group=job_group(&jobs[idx]);
+      queue.order[idx]=idx;
+    } /* for */
+    /* insertion sort, because qsort() has no context argument */
+    for (idx=1; idx<count; idx++) {
+      int value=queue.order[idx];
+      int pos;
+      for (pos=idx; pos>0 && compare_jobs(jobs,queue.order[pos-1],value)>0; pos--)
+        queue.order[pos]=queue.order[pos-1];
+      queue.order[pos]=value;
+    } /* for */
+    for (idx=0; idx<count; idx++) {
+      if (idx==0 || jobs[queue.order[idx]].group!=jobs[queue.order[idx-1]].group) {
+        queue.groups[queue.numgroups].next=idx;
+        queue.groups[queue.numgroups].workers=0;
+        queue.numgroups++;
+      } /* if */
+      queue.groups[queue.numgroups-1].end=idx+1;
+    } /* for */
+    batch_initlock(&queue.lock);
+    batch_initsignal(&queue.finished);
+
+    for (started=0; started<workers; started++) {
+      #if defined __WIN32__ || defined _WIN32 || defined _Windows
+        if ((threads[started]=CreateThread(NULL,0,batch_worker,&queue,0,NULL))==NULL)
+          break;
+      #else
+        if (pthread_create(&threads[started],NULL,batch_worker,&queue)!=0)
+          break;
+      #endif
+    } /* for */
+    if (started>0) {
+      /* print the results in the order of the jobs, as soon as they are done */
+      for (idx=0; idx<count; idx++) {
+        batch_lock(&queue.lock);
+        while (!jobs[idx].done)
+          batch_wait(&queue.finished,&queue.lock);
+        batch_unlock(&queue.lock);
+        report_job(&jobs[idx],idx,count);
+      } /* for */
+    } /* if */
+    while (started-->0) {
+      #if defined __WIN32__ || defined _WIN32 || defined _Windows
+        WaitForSingleObject(threads[started],INFINITE);
+        CloseHandle(threads[started]);
+      #else
+        pthread_join(threads[started],NULL);
+      #endif
+    } /* while */
+
+    batch_deletesignal(&queue.finished);
+    batch_deletelock(&queue.lock);
+    free(queue.order);
+    free(queue.groups);
+    free(threads);
+    return count==0 || jobs[count-1].done;
+  }
+#endif /* PAWNC_REENTRANT */
+
+/* compilebatch()
+ * Compiles a list of jobs in the same process. With option -B, the list comes
+ * from a manifest file: every line in the manifest holds the source files,
+ * options and output file of a job, in the same syntax as the command line.
+ * Empty lines and lines starting with a '#' are ignored. Without -B, every
+ * source file on the command line is a job of its own; options that set the
+ * name of an output file (-o, -e, -M and -r with a name) are then refused for
+ * more than one source file, because all jobs would write to the same file.
+ * The options on the command line (apart from -B and -j) apply to all jobs
+ * and come before the arguments of the job.
+ * The tables that do not change between compiles (the peephole optimizer
+ * sequences, the codepage, a snapshot of the prefix file and the contents of
+ * the source files that were read) are kept for the next job.
+ * With option -j, the jobs are compiled by a pool of worker threads (if the
+ * compiler is built with PAWNC_REENTRANT). A failing job does not stop the
+ * other jobs, and the results are reported in the order of the jobs.
+ */
+static int compilebatch(int argc,char *argv[],int batcharg,int workers)
+{
+  char line[4096];
+  batchjob *jobs=NULL;
+  int count,idx,failed,workerarg,arg,ok;
+  unsigned long start;
+  FILE *fp;
+
+  for (workerarg=argc-1; workerarg>0; workerarg--)
+    if (workerarg!=batcharg && argv[workerarg][1]=='j'
+        && (argv[workerarg][0]=='-' || (DIRSEP_CHAR!='/' && argv[workerarg][0]=='/')))
+      break;
+  if (workerarg==0)
+    workerarg=-1;               /* no option -j */
+  count=0;
+  ok=TRUE;
+  if (batcharg>0) {
+    char *manifest=argv[batcharg]+2;
+    if ((fp=fopen(manifest,"r"))==NULL) {
+      pc_printf("cannot read from batch file \"%s\"\n",manifest);
+      return 1;
+    } /* if */
+    while (ok && fgets(line,sizeof line,fp)!=NULL)
+      ok=add_job(&jobs,&count,argc,argv,batcharg,workerarg,line);
+    fclose(fp);
+  } else {
+    /* the source files on the command line are separate jobs; they are
+     * removed from the common arguments
+     */
+    char **options=(char**)malloc((argc+1)*sizeof(char*));
+    int numoptions=0,numsources=0,outputarg=0;
+    ok=(options!=NULL);
+    for (arg=0; ok && arg<argc; arg++) {
+      if (arg==workerarg)
+        continue;
+      if (arg==0 || argv[arg][0]=='-' || argv[arg][0]=='@'
+          || (DIRSEP_CHAR!='/' && argv[arg][0]=='/'))
+      {
+        options[numoptions++]=argv[arg];
+        if (arg>0 && argv[arg][0]!='@' && argv[arg][1]!='\0'
+            && strchr("oeMr",argv[arg][1])!=NULL && *option_value(argv[arg]+1)!='\0')
+          outputarg=arg;        /* option with the name of an output file */
+      } else {
+        numsources++;
+      } /* if */
+    } /* for */
+    if (ok && outputarg>0 && numsources>1) {
+      pc_printf("option \"%s\" cannot be used with several source files and -j;\n"
+                "every source file is a separate job, use -B to set the files per job\n",
+                argv[outputarg]);
+      free(options);
+      return 1;
+    } /* if */
+    for (arg=1; ok && arg<argc; arg++) {
+      if (arg==workerarg || argv[arg][0]=='-' || argv[arg][0]=='@'
+          || (DIRSEP_CHAR!='/' && argv[arg][0]=='/'))
+        continue;
+      if (strchr(argv[arg],' ')!=NULL) {
+        strlcpy(line,"\"",sizeof line);
+        strlcat(line,argv[arg],sizeof line);
+        strlcat(line,"\"",sizeof line);
+      } else {
+        strlcpy(line,argv[arg],sizeof line);
+      } /* if */
+      ok=add_job(&jobs,&count,numoptions,options,-1,-1,line);
+    } /* for */
+    if (options!=NULL) {
+      /* the jobs hold a copy of the pointers, not of the array */
+      free(options);
+    } /* if */
+  } /* if */
+  start=timer_ms();
+  if (ok) {
+    int parallel=FALSE;
+    #if defined PAWNC_REENTRANT
+      if (workers>count)
+        workers=count;
+      if (workers>1)
+        parallel=run_parallel(jobs,count,workers);
+    #endif
+    if (!parallel) {
+      pc_keepstate=TRUE;
+      for (idx=0; idx<count; idx++) {
+        run_job(&jobs[idx]);
+        report_job(&jobs[idx],idx,count);
+      } /* for */
+      pc_keepstate=FALSE;
+      phopt_cleanup();
+      pch_delete();
+    } /* if */
+  } else {
+    pc_printf("insufficient memory for the list of jobs\n");
+  } /* if */
+
+  failed=0;
+  for (idx=0; idx<count; idx++) {
+    if (jobs[idx].retcode!=0)
+      failed++;
+    free(jobs[idx].argv);
+    free(jobs[idx].line);
+    free(jobs[idx].output);
+  } /* for */
+  free(jobs);
+  if (!ok)
+    return 1;
+  pc_printf("%d job%s, %d failed (%lu ms)\n",count,(count==1) ? "" : "s",failed,
+            timer_ms()-start);
+  return (failed>0) ? 1 : 0;
+}
+
+#if defined PAWN_SERVER
+
+#define SERVER_MAGIC      "PAWNSRV1"
+#define SERVER_MAXREQUEST 0x100000L     /* maximum size of a request */
+
+static void srccache_verify(void);
+
+static int write_all(int fd,const void *buffer,size_t size)
+{
+  const char *ptr=(const char*)buffer;
+  ssize_t count;
+
+  while (size>0) {
+    if ((count=write(fd,ptr,size))<0) {
+      if (errno==EINTR)
+        continue;
+      return FALSE;
+    } /* if */
+    ptr+=count;
+    size-=(size_t)count;
+  } /* while */
+  return TRUE;
+}
+
+/* read_all() reads until the other side closes the connection; it returns
+ * the number of bytes read, or -1 on an error
+ */
+static long read_all(int fd,char **buffer,long limit)
+{
+  long size=0,top=0;
+  ssize_t count;
+
+  *buffer=NULL;
+  for ( ;; ) {
+    if (size-top<4096) {
+      char *block;
+      if (size>=limit || (block=(char*)realloc(*buffer,size+65536L))==NULL)
+        break;
+      *buffer=block;
+      size+=65536L;
+    } /* if */
+    if ((count=read(fd,*buffer+top,size-top))<0) {
+      if (errno==EINTR)
+        continue;
+      break;
+    } /* if */
+    if (count==0)
+      return top;
+    top+=(long)count;
+  } /* for */
+  free(*buffer);
+  *buffer=NULL;
+  return -1;
+}
+
+static int open_socket(const char *socketname,struct sockaddr_un *addr)
+{
+  if (strlen(socketname)>=sizeof addr->sun_path) {
+    pc_printf("socket name too long: \"%s\"\n",socketname);
+    return -1;
+  } /* if */
+  memset(addr,0,sizeof(struct sockaddr_un));
+  addr->sun_family=AF_UNIX;
+  strlcpy(addr->sun_path,socketname,sizeof addr->sun_path);
+  return socket(AF_UNIX,SOCK_STREAM,0);
+}
+
+/* A request holds a series of zero-terminated strings: the magic string, the
+ * working directory of the client, the number of arguments and the arguments
+ * (starting with argv[0]). The reply is the output of the compile, as a
+ * series of messages that each start with a byte for the stream (1=stdout,
+ * 2=stderr) and end with a zero byte; it closes with a zero byte followed by
+ * the exit code (as a zero-terminated string).
+ */
+static void serve_request(int client)
+{
+  char *request,*ptr,*end,*cwd;
+  char **args=NULL;
+  char retcode[20];
+  batchjob job;
+  long size;
+  int argc,arg;
+
+  memset(&job,0,sizeof job);
+  job.retcode=1;
+  if ((size=read_all(client,&request,SERVER_MAXREQUEST))<=0)
+    return;
+  end=request+size;
+  ptr=request;
+  argc=-1;
+  if (memchr(request,'\0',size)!=NULL && strcmp(request,SERVER_MAGIC)==0) {
+    ptr+=strlen(ptr)+1;
+    cwd=ptr;
+    if (ptr<end && memchr(ptr,'\0',end-ptr)!=NULL) {
+      ptr+=strlen(ptr)+1;
+      if (ptr<end && memchr(ptr,'\0',end-ptr)!=NULL) {
+        argc=atoi(ptr);
+        ptr+=strlen(ptr)+1;
+      } /* if */
+    } /* if */
+  } /* if */
+  if (argc>0 && (args=(char**)malloc((argc+1)*sizeof(char*)))!=NULL) {
+    for (arg=0; arg<argc && ptr<end && memchr(ptr,'\0',end-ptr)!=NULL; arg++) {
+      args[arg]=ptr;
+      ptr+=strlen(ptr)+1;
+    } /* for */
+    args[arg]=NULL;
+    if (arg<argc)
+      argc=-1;                  /* truncated request */
+  } /* if */
+
+  capturejob=&job;
+  if (argc<=0 || args==NULL) {
+    pc_printf("invalid request\n");
+  } else if (chdir(cwd)!=0) {
+    pc_printf("cannot change to directory \"%s\"\n",cwd);
+  } else {
+    /* files may have changed since the previous request, and relative names
+     * may refer to other files in another directory
+     */
+    srccache_verify();
+    delete_utf8cache();
+    delete_pathcache();
+    job.argc=argc;
+    job.argv=args;
+    job.label=(argc>1) ? args[argc-1] : args[0];
+    for (arg=1; arg<argc; arg++) {
+      if (args[arg][0]!='-' && args[arg][0]!='@') {
+        job.label=args[arg];    /* first source file */
+        break;
+      } /* if */
+    } /* for */
+    run_job(&job);
+  } /* if */
+  capturejob=NULL;
+
+  sprintf(retcode,"%c%d",'\0',job.retcode);
+  if (write_all(client,job.output,job.outputtop))
+    write_all(client,retcode,strlen(retcode+1)+2);
+  if (job.argv!=NULL)
+    pc_printf("%s: %s (%d error%s, %d warning%s, %lu ms)\n",
+              job.label,(job.retcode==0) ? "ok" : "FAILED",
+              job.errors,(job.errors==1) ? "" : "s",
+              job.warnings,(job.warnings==1) ? "" : "s",job.time);
+  free(job.output);
+  free(args);
+  free(request);
+}
+
+/* compileserver()
+ * Listens on a local socket and runs the compiles that are requested, one at
+ * a time. The tables that compilebatch() keeps between jobs are kept between
+ * requests; the source files in the cache are checked against the file system
+ * on every request. The socket is only accessible for the current user.
+ */
+static int compileserver(const char *socketname)
+{
+  struct sockaddr_un addr;
+  struct stat info;
+  char home[_MAX_PATH];
+  int server,client;
+  mode_t mask;
+
+  if ((server=open_socket(socketname,&addr))<0)
+    return 1;
+  if (connect(server,(struct sockaddr*)&addr,sizeof addr)==0) {
+    pc_printf("a compile server is already running on \"%s\"\n",socketname);
+    close(server);
+    return 1;
+  } /* if */
+  /* remove a stale socket, but never a file that is not a socket */
+  if (lstat(socketname,&info)==0) {
+    if (!S_ISSOCK(info.st_mode)) {
+      pc_printf("\"%s\" exists and is not a socket\n",socketname);
+      close(server);
+      return 1;
+    } /* if */
+    unlink(socketname);
+  } /* if */
+  mask=umask(077);
+  if (bind(server,(struct sockaddr*)&addr,sizeof addr)!=0 || listen(server,16)!=0) {
+    umask(mask);
+    pc_printf("cannot listen on \"%s\"\n",socketname);
+    close(server);
+    return 1;
+  } /* if */
+  umask(mask);
+  if (getcwd(home,sizeof home)==NULL)
+    strcpy(home,".");
+  signal(SIGPIPE,SIG_IGN);      /* a client that disconnects must not stop the server */
+  pc_printf("compile server listening on \"%s\"\n",socketname);
+
+  pc_keepstate=TRUE;
+  for ( ;; ) {
+    if ((client=accept(server,NULL,NULL))<0) {
+      if (errno==EINTR || errno==ECONNABORTED)
+        continue;
+      break;
+    } /* if */
+    serve_request(client);
+    close(client);
+    if (chdir(home)!=0)
+      break;
+  } /* for */
+  pc_keepstate=FALSE;
+  phopt_cleanup();
+  pch_delete();
+  close(server);
+  unlink(socketname);
+  return 1;
+}
+
+/* compileclient()
+ * Sends the compile to a server and prints its output. The function returns
+ * -1 if there is no server (the caller then compiles locally).
+ */
+static int compileclient(int argc,char *argv[],int clientarg)
+{
+  struct sockaddr_un addr;
+  char cwd[_MAX_PATH],count[20];
+  char *reply,*ptr,*end;
+  long size;
+  int server,arg,ok,retcode;
+
+  if ((server=open_socket(argv[clientarg]+2,&addr))<0)
+    return -1;
+  if (connect(server,(struct sockaddr*)&addr,sizeof addr)!=0
+      || getcwd(cwd,sizeof cwd)==NULL)
+  {
+    close(server);
+    return -1;
+  } /* if */
+  sprintf(count,"%d",argc-1);
+  ok=write_all(server,SERVER_MAGIC,strlen(SERVER_MAGIC)+1)
+     && write_all(server,cwd,strlen(cwd)+1)
+     && write_all(server,count,strlen(count)+1);
+  for (arg=0; ok && arg<argc; arg++)
+    if (arg!=clientarg)
+      ok=write_all(server,argv[arg],strlen(argv[arg])+1);
+  shutdown(server,SHUT_WR);
+  size=ok ? read_all(server,&reply,LONG_MAX) : -1;
+  close(server);
+  if (size<0)
+    return -1;
+
+  retcode=1;
+  end=reply+size;
+  for (ptr=reply; ptr<end && memchr(ptr,'\0',end-ptr)!=NULL; ptr+=strlen(ptr+1)+2) {
+    FILE *stream;
+    if (*ptr=='\0') {
+      retcode=atoi(ptr+1);
+      break;
+    } /* if */
+    stream=(*ptr==2) ? stderr : stdout;
+    fputs(ptr+1,stream);
+    fflush(stream);
+  } /* for */
+  free(reply);
+  return retcode;
+}
+
+#endif /* PAWN_SERVER */
+
 /* pc_printf()
  * Called for general purpose "console" output. This function prints general
  * purpose messages; errors go through pc_error(). The function is modelled
@@ -179,7 +1077,10 @@ int pc_printf(const char *message,...)
   va_list argptr;
 
   va_start(argptr,message);
-  ret=vprintf(message,argptr);
+  if (capturejob!=NULL)
+    ret=capture_output(1,message,argptr);
+  else
+    ret=vprintf(message,argptr);
   va_end(argptr);
   fflush(stdout);
 
@@ -204,20 +1105,163 @@ int pc_error(int number,char *message,char *filename,int firstline,int lastline,
 {
 static char *prefix[3]={ "error", "fatal error", "warning" };
 
+  char header[_MAX_PATH+64];
+
+  header[0]='\0';
   if (number!=0) {
     char *pre;
 
     pre=prefix[number/100];
     if (firstline>=0)
-      fprintf(stderr,"%s(%d -- %d) : %s %03d: ",filename,firstline,lastline,pre,number);
+      snprintf(header,sizeof header,"%s(%d -- %d) : %s %03d: ",filename,firstline,lastline,pre,number);
     else
-      fprintf(stderr,"%s(%d) : %s %03d: ",filename,lastline,pre,number);
+      snprintf(header,sizeof header,"%s(%d) : %s %03d: ",filename,lastline,pre,number);
+  } /* if */
+  if (capturejob!=NULL) {
+    capture_printf(2,"%s",header);
+    capture_output(2,message,argptr);
+  } else {
+    fputs(header,stderr);
+    vfprintf(stderr,message,argptr);
+    fflush(stderr);
   } /* if */
-  vfprintf(stderr,message,argptr);
-  fflush(stderr);
   return 0;
 }
 
+/* The source files are read into memory in a single operation, when they are
+ * opened; from there on, the compiler reads lines from the memory buffer.
+ * Marking a position or rewinding the file (for every pass) is then reduced
+ * to saving or restoring an offset. A source file that is created for writing
+ * (see pc_createsrc()) just wraps a FILE pointer.
+ *
+ * The file contents are kept in a cache for the lifetime of the process, so
+ * that an include file that is opened again (in every pass, or for another
+ * script) is read from disk only once.
+ */
+typedef struct s_srccache {
+  struct s_srccache *next;
+  char *name;           /* file name, as passed to pc_opensrc() */
+  unsigned char *buffer;/* full file contents */
+  size_t size;          /* number of bytes in the buffer */
+  #if defined PAWN_SERVER
+    struct stat info;   /* to detect a change of the file (compile server) */
+    time_t loaded;      /* time at which the file was read */
+  #endif
+} srccache;
+
+typedef struct s_srcfile {
+  FILE *fp;             /* only for files opened for writing */
+  const unsigned char *buffer;/* file contents (owned by the cache) */
+  size_t size;          /* number of bytes in the buffer */
+  size_t pos;           /* current read position */
+  int eof;              /* set when a read hit the end of the buffer */
+} srcfile;
+
+SC_VSTATIC srccache *srccache_root=NULL;
+
+static srccache *srccache_load(char *filename)
+{
+  FILE *fp;
+  srccache *entry;
+  size_t bufsize,count;
+  long length;
+
+  for (entry=srccache_root; entry!=NULL; entry=entry->next)
+    if (strcmp(entry->name,filename)==0)
+      return entry;
+
+  if ((fp=fopen(filename,"r"))==NULL)
+    return NULL;
+  if ((entry=(srccache*)malloc(sizeof(srccache)))==NULL) {
+    fclose(fp);
+    return NULL;
+  } /* if */
+  memset(entry,0,sizeof(srccache));
+  #if defined PAWN_SERVER
+    entry->loaded=time(NULL);
+    fstat(fileno(fp),&entry->info);
+  #endif
+  /* the file length is only a hint: in text mode, the number of bytes read
+   * may be less than the file size
+   */
+  bufsize=0;
+  if (fseek(fp,0,SEEK_END)==0 && (length=ftell(fp))>0)
+    bufsize=(size_t)length+1;
+  fseek(fp,0,SEEK_SET);
+  if (bufsize<256)
+    bufsize=256;
+  for ( ;; ) {
+    unsigned char *buffer=(unsigned char*)realloc(entry->buffer,bufsize);
+    if (buffer==NULL) {
+      free(entry->buffer);
+      entry->buffer=NULL;
+      break;
+    } /* if */
+    entry->buffer=buffer;
+    count=fread(entry->buffer+entry->size,1,bufsize-entry->size,fp);
+    entry->size+=count;
+    if (entry->size<bufsize)
+      break;                    /* end of file (or read error) */
+    bufsize*=2;
+  } /* for */
+  fclose(fp);
+  if (entry->buffer==NULL || (entry->name=duplicatestring(filename))==NULL) {
+    free(entry->buffer);
+    free(entry);
+    return NULL;
+  } /* if */
+  entry->next=srccache_root;
+  srccache_root=entry;
+  return entry;
+}
+
+static void srccache_remove(char *filename)
+{
+  srccache *entry,*prev;
+
+  for (prev=NULL, entry=srccache_root; entry!=NULL; prev=entry, entry=entry->next) {
+    if (strcmp(entry->name,filename)==0) {
+      if (prev!=NULL)
+        prev->next=entry->next;
+      else
+        srccache_root=entry->next;
+      free(entry->name);
+      free(entry->buffer);
+      free(entry);
+      return;
+    } /* if */
+  } /* for */
+}
+
+#if defined PAWN_SERVER
+/* srccache_verify() removes the files that changed, or that are no longer
+ * the same file (for a relative name in another directory). The time stamps
+ * have a resolution of one second, so a file that was modified in the same
+ * second as it was read may have changed again without a change in its time
+ * stamp; such a file is read again too.
+ */
+static void srccache_verify(void)
+{
+  srccache *entry,*next;
+  struct stat info;
+
+  for (entry=srccache_root; entry!=NULL; entry=next) {
+    next=entry->next;
+    if (stat(entry->name,&info)!=0 || info.st_dev!=entry->info.st_dev
+        || info.st_ino!=entry->info.st_ino || info.st_size!=entry->info.st_size
+        || info.st_mtime!=entry->info.st_mtime || info.st_ctime!=entry->info.st_ctime
+        || entry->info.st_mtime>=entry->loaded || entry->info.st_ctime>=entry->loaded)
+      srccache_remove(entry->name);
+  } /* for */
+}
+#endif
+
+static void delete_srccache(void)
+{
+  while (srccache_root!=NULL)
+    srccache_remove(srccache_root->name);
+}
+
 /* pc_opensrc()
  * Opens a source file (or include file) for reading. The "file" does not have
  * to be a physical file, one might compile from memory.
@@ -232,7 +1276,17 @@ static char *prefix[3]={ "error", "fatal error", "warning" };
  */
 void *pc_opensrc(char *filename)
 {
-  return fopen(filename,"r");
+  srccache *entry;
+  srcfile *src;
+
+  if ((entry=srccache_load(filename))==NULL)
+    return NULL;
+  if ((src=(srcfile*)malloc(sizeof(srcfile)))==NULL)
+    return NULL;
+  memset(src,0,sizeof(srcfile));
+  src->buffer=entry->buffer;
+  src->size=entry->size;
+  return src;
 }
 
 /* pc_createsrc()
@@ -249,7 +1303,19 @@ void *pc_opensrc(char *filename)
  */
 void *pc_createsrc(char *filename)
 {
-  return fopen(filename,"w");
+  FILE *fp;
+  srcfile *src;
+
+  srccache_remove(filename);    /* a cached copy would become stale */
+  if ((fp=fopen(filename,"w"))==NULL)
+    return NULL;
+  if ((src=(srcfile*)malloc(sizeof(srcfile)))==NULL) {
+    fclose(fp);
+    return NULL;
+  } /* if */
+  memset(src,0,sizeof(srcfile));
+  src->fp=fp;
+  return src;
 }
 
 /* pc_closesrc()
@@ -258,17 +1324,47 @@ void *pc_createsrc(char *filename)
  */
 void pc_closesrc(void *handle)
 {
+  srcfile *src=(srcfile*)handle;
+
   assert(handle!=NULL);
-  fclose((FILE*)handle);
+  if (src->fp!=NULL)
+    fclose(src->fp);
+  free(src);
 }
 
 /* pc_readsrc()
  * Reads a single line from the source file (or up to a maximum number of
- * characters if the line in the input file is too long).
+ * characters if the line in the input file is too long). The semantics are
+ * those of fgets().
  */
 char *pc_readsrc(void *handle,unsigned char *target,int maxchars)
 {
-  return fgets((char*)target,maxchars,(FILE*)handle);
+  srcfile *src=(srcfile*)handle;
+  const unsigned char *start,*ptr;
+  size_t count;
+
+  assert(handle!=NULL && src->fp==NULL);
+  if (maxchars<=0)
+    return NULL;
+  if (src->pos>=src->size) {
+    src->eof=TRUE;
+    return NULL;
+  } /* if */
+  start=src->buffer+src->pos;
+  count=src->size-src->pos;
+  if (count>=(size_t)maxchars) {
+    count=maxchars-1;           /* line is too long, return a partial line */
+  } else {
+    src->eof=TRUE;              /* may be reset below, if '\n' is found */
+  } /* if */
+  if ((ptr=(const unsigned char*)memchr(start,'\n',count))!=NULL) {
+    count=(size_t)(ptr-start)+1;
+    src->eof=FALSE;
+  } /* if */
+  memcpy(target,start,count);
+  target[count]='\0';
+  src->pos+=count;
+  return (char*)target;
 }
 
 /* pc_writesrc()
@@ -277,12 +1373,15 @@ char *pc_readsrc(void *handle,unsigned char *target,int maxchars)
  */
 int pc_writesrc(void *handle,const unsigned char *source)
 {
-  return fputs((char*)source,(FILE*)handle) >= 0;
+  srcfile *src=(srcfile*)handle;
+
+  assert(handle!=NULL && src->fp!=NULL);
+  return fputs((char*)source,src->fp) >= 0;
 }
 
 #define MAXPOSITIONS  4
-static fpos_t srcpositions[MAXPOSITIONS];
-static unsigned char srcposalloc[MAXPOSITIONS];
+SC_VSTATIC size_t srcpositions[MAXPOSITIONS];
+SC_VSTATIC unsigned char srcposalloc[MAXPOSITIONS];
 
 void pc_clearpossrc(void)
 {
@@ -304,9 +1403,9 @@ void *pc_getpossrc(void *handle,void *position)
     srcposalloc[i]=1;
   } else {
     /* use the gived slot */
-    assert(position>=srcpositions && position<srcpositions+sizeof(srcpositions));
+    assert((size_t*)position>=srcpositions && (size_t*)position<srcpositions+MAXPOSITIONS);
   } /* if */
-  fgetpos((FILE*)handle,(fpos_t*)position);
+  *(size_t*)position=((srcfile*)handle)->pos;
   return position;
 }
 
@@ -316,15 +1415,18 @@ void *pc_getpossrc(void *handle,void *position)
  */
 void pc_resetsrc(void *handle,void *position)
 {
+  srcfile *src=(srcfile*)handle;
+
   assert(handle!=NULL);
   assert(position!=NULL);
-  fsetpos((FILE*)handle,(fpos_t*)position);
+  src->pos=*(size_t*)position;
+  src->eof=FALSE;
   /* note: the item is not cleared from the pool */
 }
 
 int pc_eofsrc(void *handle)
 {
-  return feof((FILE*)handle);
+  return ((srcfile*)handle)->eof;
 }
 
 /* should return a pointer, which is used as a "magic cookie" to all I/O
@@ -435,18 +1537,21 @@ int pc_compile(int argc, char *argv[])
   char incfname[_MAX_PATH];
   char reportname[_MAX_PATH];
   char codepage[MAXCODEPAGE+1];
-  char *tmpname;  /* temporary input file name */
   FILE *binf;
   void *inpfmark;
   int lcl_packstr,lcl_needsemicolon,lcl_tabsize;
+  int usepch,cachehit;
   #if !defined PAWN_LIGHT
     int hdrsize=0;
+    int savepch=FALSE;
+    int usecache=FALSE;
   #endif
   char *ptr;
 
   /* set global variables to their initial value */
   binf=NULL;
-  tmpname=NULL;
+  usepch=FALSE;
+  cachehit=FALSE;
   initglobals();
   errorset(sRESET,0);
   errorset(sEXPRRELEASE,0);
@@ -494,50 +1599,22 @@ int pc_compile(int argc, char *argv[])
     if (!cp_set(codepage))      /* set codepage */
       error(108);               /* codepage mapping file not found */
   #endif
-  /* optionally create a temporary input file that is a collection of all
-   * input files
+  #if !defined PAWN_LIGHT
+    /* with a cache, the output file of an earlier compile may be reused */
+    if (strlen(cachedir)>0 && !sc_makereport) {
+      usecache=cachekey(incfname,codepage);
+      if (usecache && cache_fetch((sc_asmfile || sc_listing) ? outfname : binfname)) {
+        cachehit=TRUE;
+        goto cleanup;
+      } /* if */
+    } /* if */
+  #endif
+  /* with several source files, readline() opens each next source file at the
+   * end of the previous one, as if these were a single file
    */
   assert(get_sourcefile(0)!=NULL);  /* there must be at least one source file */
-  if (get_sourcefile(1)!=NULL) {
-    /* there are at least two or more source files */
-    char *sname;
-    FILE *ftmp,*fsrc;
-    int fidx;
-    #if defined	__WIN32__ || defined _WIN32
-      tmpname=_tempnam(NULL,"pawn");
-    #elif defined __MSDOS__ || defined _Windows
-      tmpname=tempnam(NULL,"pawn");
-    #elif defined(MACOS) && !defined(__MACH__)
-      /* tempnam is not supported for the Macintosh CFM build. */
-      error(104,get_sourcefile(1));
-      tmpname=NULL;
-      sname=NULL;
-    #else
-      tmpname=tempnam(NULL,"pawn");
-    #endif
-    ftmp=(FILE*)pc_createsrc(tmpname);
-    for (fidx=0; (sname=get_sourcefile(fidx))!=NULL; fidx++) {
-      unsigned char tstring[128];
-      fsrc=(FILE*)pc_opensrc(sname);
-      if (fsrc==NULL) {
-        pc_closesrc(ftmp);
-        remove(tmpname);
-        strcpy(inpfname,sname); /* avoid invalid filename */
-        error(100,sname);       /* fatal error, aborts program */
-      } /* if */
-      pc_writesrc(ftmp,(unsigned char*)"#file \"");
-      pc_writesrc(ftmp,(unsigned char*)sname);
-      pc_writesrc(ftmp,(unsigned char*)"\"\n#line 0\n");
-      while (pc_readsrc(fsrc,tstring,sizeof tstring))
-        pc_writesrc(ftmp,tstring);
-      pc_closesrc(fsrc);
-    } /* for */
-    pc_closesrc(ftmp);
-    strcpy(inpfname,tmpname);
-  } else {
-    assert(tmpname==NULL);
-    strcpy(inpfname,get_sourcefile(0));
-  } /* if */
+  strcpy(inpfname,get_sourcefile(0));
+  inpf_index=0;
   inpf_org=(FILE*)pc_opensrc(inpfname);
   if (inpf_org==NULL)
     error(100,inpfname);
@@ -558,6 +1635,18 @@ int pc_compile(int argc, char *argv[])
     if (pc_readsrc(inpf_org,srcline,sLINEMAX)!=NULL)
       fline++;                  /* keep line number up to date */
   skipinput=fline;
+  #if !defined PAWN_LIGHT
+    /* use the precompiled prefix file if it is valid, or make one from a
+     * separate parse of the prefix file (it is saved if compilation succeeds)
+     */
+    if ((strlen(pchfname)>0 || pc_keepstate) && !sc_listing && !sc_makereport) {
+      usepch=pch_load(pchfname,incfname);
+      if (!usepch && !pch_failed()) {
+        usepch=prefixpass(incfname);
+        savepch=usepch && strlen(pchfname)>0;
+      } /* if */
+    } /* if */
+  #endif
   sc_status=statFIRST;
   /* write starting options (from the command line or the configuration file) */
   if (sc_listing) {
@@ -591,16 +1680,28 @@ int pc_compile(int argc, char *argv[])
     pc_tabsize=(pc_matchedtabsize<=1) ? lcl_tabsize : pc_matchedtabsize;
     errorset(sRESET,0);
     /* reset the source file */
-    inpf=inpf_org;
+    restartsource();
     freading=TRUE;
     pc_resetsrc(inpf,inpfmark); /* reset file position */
     fline=skipinput;            /* reset line number */
     sc_reparse=FALSE;           /* assume no extra passes */
     sc_status=statFIRST;        /* resetglobals() resets it to IDLE */
 
-    plungeprefix(incfname);     /* jump into "default.inc" or alternative prefix file */
-    preprocess();               /* fetch first line */
-    parse();                    /* process all input */
+    if (usepch)
+      pch_apply();              /* restore the state after "default.inc" */
+    else
+      plungeprefix(incfname);   /* jump into "default.inc" or alternative prefix file */
+    if (sc_expandonly) {
+      /* run all lines through the preprocessor, which copies them to the
+       * list file; there is no parsing, so there is also no reason for
+       * another pass
+       */
+      while (freading)
+        preprocess();
+    } else {
+      preprocess();             /* fetch first line */
+      parse();                  /* process all input */
+    } /* if */
     sc_parsenum++;
   } while (sc_reparse);
 
@@ -645,7 +1746,7 @@ int pc_compile(int argc, char *argv[])
   pc_tabsize=(pc_matchedtabsize<=1) ? lcl_tabsize : pc_matchedtabsize;
   errorset(sRESET,0);
   /* reset the source file */
-  inpf=inpf_org;
+  restartsource();
   freading=TRUE;
   pc_resetsrc(inpf,inpfmark);   /* reset file position */
   fline=skipinput;              /* reset line number */
@@ -660,7 +1761,10 @@ int pc_compile(int argc, char *argv[])
   delete_symbols(&glbtab,0,TRUE,FALSE);
   insert_dbgfile(inpfname);     /* attach to debug information */
   insert_inputfile(inpfname);   /* save for the error system */
-  plungeprefix(incfname);       /* jump into "default.inc" or alternative prefix file */
+  if (usepch)
+    pch_apply();                /* restore the state after "default.inc" */
+  else
+    plungeprefix(incfname);     /* jump into "default.inc" or alternative prefix file */
   preprocess();                 /* fetch first line */
   parse();                      /* process all input */
   /* inpf is already closed when readline() attempts to pop of a file */
@@ -675,13 +1779,17 @@ cleanup:
   if (inpf!=NULL)               /* main source file is not closed, do it now */
     pc_closesrc(inpf);
   /* write the binary file (the file is already open) */
-  if (!(sc_asmfile || sc_listing) && errnum==0 && jmpcode==0) {
+  if (!(sc_asmfile || sc_listing) && errnum==0 && jmpcode==0 && !cachehit) {
     assert(binf!=NULL);
     pc_resetasm(outf);          /* flush and loop back, for reading */
     #if !defined PAWN_LIGHT
       hdrsize=
     #endif
     assemble(binf,outf);        /* assembler file is now input */
+    #if !defined PAWN_LIGHT
+      if (savepch)
+        pch_save(pchfname);
+    #endif
   } /* if */
   if (outf!=NULL) {
     pc_closeasm(outf,!(sc_asmfile || sc_listing));
@@ -691,9 +1799,13 @@ cleanup:
     pc_closebin(binf,errnum!=0);
     binf=NULL;
   } /* if */
+  #if !defined PAWN_LIGHT
+    if (sc_makedeps && errnum==0 && jmpcode==0)
+      make_depfile((sc_asmfile || sc_listing) ? outfname : binfname);
+  #endif
 
   #if !defined PAWN_LIGHT
-    if (errnum==0 && strlen(errfname)==0) {
+    if (errnum==0 && strlen(errfname)==0 && !cachehit) {
       int recursion;
       int flag_exceed=0;
       long stacksize=max_stacksize(&glbtab,&recursion);
@@ -735,33 +1847,25 @@ cleanup:
         if (pc_amxram>0)
           pc_printf(" plus %ld bytes for data/stack",(long)(glb_declared+pc_stksize)*sizeof(cell));
         pc_printf("\n");
+        if (verbosity>=3)
+          report_stacksizes(&glbtab);
       } /* if */
       if (pc_overlays>1 && max_ovlsize>pc_overlays)
         error(112,max_ovlsize-((ucell)1<<4*sizeof(cell))); //??? should also tell which function is causing this error
       if (flag_exceed)
         error(106,pc_amxlimit+pc_amxram); /* this causes a jump back to label "cleanup" */
     } /* if */
+    if (usecache && !cachehit && errnum==0 && jmpcode==0)
+      cache_store((sc_asmfile || sc_listing) ? outfname : binfname);
   #endif
 
-  if (tmpname!=NULL) {
-    remove(tmpname);
-    #if defined FORTIFY
-      /* Fortify does not know about the memory allocated by tempnam(), so
-       * it should not check the "free()" call for that memory
-       */
-      Fortify_Enable(FORTIFY_OFF);
-    #endif
-    free(tmpname);
-    #if defined FORTIFY
-      Fortify_Enable(FORTIFY_ENABLED);
-    #endif
-  } /* if */
   if (inpfname!=NULL)
     free(inpfname);
   if (litq!=NULL)
     free(litq);
   /* when aborting inside an include file, pop off and erase all names on the stack */
   while ((i=POPSTK_I())!=-1) {
+    (void)POPSTK_I();   /* fscope */
     (void)POPSTK_I();   /* fcurrent */
     (void)POPSTK_I();   /* icomment */
     (void)POPSTK_I();   /* sc_is_utf8 */
@@ -772,10 +1876,14 @@ cleanup:
     assert(inpfname!=NULL && (int)inpfname!=-1);
     free(inpfname);
     assert(inpf!=NULL && (int)inpf!=-1);
-    fclose(inpf);
+    pc_closesrc(inpf);
   } /* if */
+  /* when a later source file was active, the main file is still open */
+  if (inpf_index>0 && inpf_org!=NULL)
+    pc_closesrc(inpf_org);
   lexinit(TRUE);                          /* reset and release buffers */
-  phopt_cleanup();
+  if (!pc_keepstate)
+    phopt_cleanup();
   stgbuffer_cleanup();
   clearstk();
   assert(jmpcode!=0 || loctab.next==NULL);/* on normal flow, local symbols
@@ -783,6 +1891,7 @@ cleanup:
   delete_symbols(&loctab,0,TRUE,TRUE);    /* delete local variables if not yet
                                            * done (i.e. on a fatal error) */
   delete_symbols(&glbtab,0,TRUE,TRUE);
+  delete_symbolpool();
   delete_consttable(&tagname_tab);
   delete_consttable(&libname_tab);
   delete_consttable(&sc_automaton_tab);
@@ -792,6 +1901,7 @@ cleanup:
   delete_pathtable();
   delete_sourcefiletable();
   delete_inputfiletable();
+  delete_dependencytable();
   delete_dbgstringtable();
   #if !defined NO_DEFINE
     delete_substtable();
@@ -805,6 +1915,16 @@ cleanup:
   #endif
   delete_autolisttable();
   delete_heaplisttable();
+  if (!pc_keepstate || errnum!=0 || jmpcode!=0)
+    pch_delete();               /* in batch mode, the snapshot is kept for the next job */
+  #if defined NO_MAIN
+    /* in a library, the files may change between two compiles, and the
+     * tables are per thread (with PAWNC_REENTRANT), so nothing is kept
+     */
+    delete_utf8cache();
+    delete_pathcache();
+    cp_set(NULL);
+  #endif
   if (errnum!=0) {
     if (strlen(errfname)==0)
       pc_printf("\n%d Error%s.\n",errnum,(errnum>1) ? "s" : "");
@@ -877,6 +1997,23 @@ int pc_addtag(const char *name)
   return tag;
 }
 
+/*  restartsource
+ *
+ *  Makes the first source file active again, for the next pass. With several
+ *  source files, the pass ended in the last one.
+ */
+static void restartsource(void)
+{
+  if (inpf_index>0) {
+    free(inpfname);
+    inpfname=duplicatestring(get_sourcefile(0));
+    if (inpfname==NULL)
+      error(103);       /* insufficient memory */
+    inpf_index=0;
+  } /* if */
+  inpf=inpf_org;
+}
+
 static void resetglobals(void)
 {
   /* reset the subset of global variables that is modified by the first pass */
@@ -897,6 +2034,7 @@ static void resetglobals(void)
   fline=0;              /* the line number in the current file */
   fnumber=0;            /* the file number in the file table (debugging) */
   fcurrent=0;           /* current file being processed (debugging) */
+  fscope=0;             /* all source files share the scope of the first one */
   sc_intest=FALSE;      /* true if inside a test */
   pc_sideeffect=0;      /* true if an expression causes a side-effect */
   pc_stmtindent=0;      /* current indent of the statement */
@@ -920,6 +2058,13 @@ static void initglobals(void)
 
   sc_asmfile=FALSE;     /* do not create .ASM file */
   sc_listing=FALSE;     /* do not create .LST file */
+  sc_expandonly=FALSE;  /* parse the source */
+  #if !defined PAWN_LIGHT
+    pchfname[0]='\0';  /* no precompiled prefix file */
+    depfname[0]='\0';  /* default name for the dependency file */
+    cachedir[0]='\0';  /* no cache for output files */
+    sc_makedeps=FALSE;  /* do not write a dependency file */
+  #endif
   skipinput=0;          /* number of lines to skip from the first input file */
   sc_ctrlchar=CTRL_CHAR;/* the escape character */
   litmax=sDEF_LITMAX;   /* current size of the literal table */
@@ -1105,6 +2250,12 @@ static void parseoptions(int argc,char **argv,char *oname,char *ename,char *pnam
           about();
         } /* switch */
         break;
+      case 'E':
+        if (*(ptr+1)!='\0')
+          about();
+        sc_listing=TRUE;        /* write the expanded source to the list file */
+        sc_expandonly=TRUE;     /* ... but skip parsing */
+        break;
       case 'e':
         strlcpy(ename,option_value(ptr),_MAX_PATH); /* set name of error file */
         break;
@@ -1142,6 +2293,18 @@ static void parseoptions(int argc,char **argv,char *oname,char *ename,char *pnam
       case 'p':
         strlcpy(pname,option_value(ptr),_MAX_PATH); /* set name of implicit include file */
         break;
+#if !defined PAWN_LIGHT
+      case 'K':
+        strlcpy(cachedir,option_value(ptr),_MAX_PATH); /* set directory for the cache */
+        break;
+      case 'M':
+        strlcpy(depfname,option_value(ptr),_MAX_PATH); /* set name of dependency file */
+        sc_makedeps=TRUE;
+        break;
+      case 'P':
+        strlcpy(pchfname,option_value(ptr),_MAX_PATH); /* set name of precompiled prefix file */
+        break;
+#endif
 #if !defined PAWN_LIGHT
       case 'r':
         strlcpy(rname,option_value(ptr),_MAX_PATH); /* set name of report file */
@@ -1318,14 +2481,19 @@ static void parserespf(char *filename,char *oname,char *ename,char *pname,
   /* allocate table for option pointers */
   if ((argv=(char **)malloc(MAX_OPTIONS*sizeof(char*)))==NULL)
     error(103);                 /* insufficient memory */
-  /* fill the options table */
-  ptr=strtok(string," \t\r\n");
-  for (argc=1; argc<MAX_OPTIONS && ptr!=NULL; argc++) {
+  /* fill the options table (strtok() is not used, because it is not
+   * reentrant)
+   */
+  ptr=string+strspn(string," \t\r\n");
+  for (argc=1; argc<MAX_OPTIONS && *ptr!='\0'; argc++) {
     /* note: the routine skips argv[0], for compatibility with main() */
     argv[argc]=ptr;
-    ptr=strtok(NULL," \t\r\n");
+    ptr+=strcspn(ptr," \t\r\n");
+    if (*ptr!='\0')
+      *ptr++='\0';
+    ptr+=strspn(ptr," \t\r\n");
   } /* for */
-  if (ptr!=NULL)
+  if (*ptr!='\0')
     error(102,"option table");   /* table overflow */
   /* parse the option table */
   parseoptions(argc,argv,oname,ename,pname,rname,codepage);
@@ -1497,6 +2665,11 @@ static void about(void)
     pc_printf("Options:\n");
     pc_printf("         -A<num>  alignment in bytes of the data segment and the stack\n");
     pc_printf("         -a       output assembler code\n");
+#if !defined NO_MAIN
+    pc_printf("         -B<name> compile the jobs in a batch file; every line holds the source\n");
+    pc_printf("                  files and options of one job (lines starting with '#' are\n");
+    pc_printf("                  ignored), the other options apply to all jobs\n");
+#endif
 #if AMX_COMPACTMARGIN > 2
     pc_printf("         -C[+/-]  compact encoding for output file (default=%c)\n", pc_compress ? '+' : '-');
 #endif
@@ -1509,18 +2682,33 @@ static void about(void)
     pc_printf("             1    run-time checks, no symbolic information\n");
     pc_printf("             2    full debug information and dynamic checking\n");
     pc_printf("             3    same as -d2, but implies -O0\n");
+    pc_printf("         -E       create list file with expanded source only (no parsing)\n");
     pc_printf("         -e<name> set name of error file (quiet compile)\n");
 #if defined	__WIN32__ || defined _WIN32 || defined _Windows
     pc_printf("         -H<hwnd> window handle to send a notification message on finish\n");
 #endif
     pc_printf("         -i<name> path for include files\n");
+#if !defined NO_MAIN
+    pc_printf("         -j[num]  compile every source file (or every job of -B) separately,\n");
+    pc_printf("                  with \"num\" compiles at the same time (default=processors);\n");
+    pc_printf("                  a failing job does not stop the other jobs\n");
+#endif
+#if !defined PAWN_LIGHT
+    pc_printf("         -K<name> directory for a cache of compiled output files\n");
+#endif
     pc_printf("         -l       create list file (preprocess only)\n");
+#if !defined PAWN_LIGHT
+    pc_printf("         -M[name] write a dependency file (for make or ninja)\n");
+#endif
     pc_printf("         -o<name> set base name of (P-code) output file\n");
     pc_printf("         -O<num>  optimization level (default=-O%d)\n",pc_optimize);
     pc_printf("             0    no optimization\n");
     pc_printf("             1    JIT-compatible optimizations only\n");
     pc_printf("             2    full optimizations\n");
     pc_printf("         -p<name> set name of the \"prefix\" file\n");
+#if !defined PAWN_LIGHT
+    pc_printf("         -P<name> use (or create) a precompiled \"prefix\" file\n");
+#endif
 #if !defined PAWN_LIGHT
     pc_printf("         -r[name] write cross reference report to console or to specified file\n");
 #endif
@@ -1529,10 +2717,17 @@ static void about(void)
     pc_printf("         -t<num>  TAB indent size (in character positions, default=%d)\n",pc_tabsize);
     pc_printf("         -T<name> set name of the configuration file to use\n");
     pc_printf("         -V<num>  generate overlay code and instructions; set buffer size\n");
-    pc_printf("         -v<num>  verbosity level; 0=quiet, 1=normal, 2=verbose (default=%d)\n",verbosity);
+    pc_printf("         -v<num>  verbosity level; 0=quiet, 1=normal, 2=verbose,\n");
+    pc_printf("                  3=verbose with stack use per public function (default=%d)\n",verbosity);
     pc_printf("         -w<num>  disable a specific warning by its number\n");
     pc_printf("         -X<num>  abstract machine size limit in bytes\n");
     pc_printf("         -XD<num> abstract machine data/stack size limit in bytes\n");
+#if defined PAWN_SERVER
+    pc_printf("         -Z<name> run as a compile server on the local socket \"name\"; the\n");
+    pc_printf("                  server keeps its tables and file caches between compiles\n");
+    pc_printf("         -z<name> pass the compile to the server on socket \"name\"; without\n");
+    pc_printf("                  a server, the compile runs locally\n");
+#endif
     pc_printf("         -\\       use '\\' for escape characters\n");
     pc_printf("         -^       use '^' for escape characters\n");
     pc_printf("         -;[+/-]  require a semicolon to end each statement (default=%c)\n", sc_needsemicolon ? '+' : '-');
@@ -1754,6 +2949,8 @@ static void plungeprefix(char *prefixname)
     if (strchr(prefixname,DIRSEP_CHAR)==NULL) {
       /* no path, search the prefix file in the include directory */
       ok=plungefile(prefixname,FALSE,TRUE);
+      if (!ok)
+        watchfile(prefixname,FALSE,TRUE);
     } else {
       /* when a path is given for the prefix file, it must be absolute */
       ok=plungequalifiedfile(prefixname);
@@ -1766,6 +2963,102 @@ static void plungeprefix(char *prefixname)
   } /* if */
 }
 
+#if !defined PAWN_LIGHT
+/*  prefixpass
+ *
+ *  Parses only the prefix file (and the files that it includes), for making
+ *  a precompiled prefix; see scpch.c. When the prefix file holds only
+ *  declarations, the snapshot is kept in memory and all symbols that the
+ *  prefix file declared are removed again (the main passes restore these
+ *  from the snapshot). The function returns FALSE if no snapshot was made,
+ *  in which case the main passes parse the prefix file as usual.
+ */
+static int prefixpass(char *prefixname)
+{
+  symbol *sym;
+  int ok;
+
+  resetglobals();
+  errorset(sRESET,0);
+  inpf=NULL;                    /* no main file, only the prefix */
+  freading=TRUE;
+  fline=0;
+  sc_status=statFIRST;
+  pch_startrecord(TRUE);
+  plungeprefix(prefixname);
+  preprocess();                 /* fetch first line */
+  parse();                      /* process all input */
+  pch_startrecord(FALSE);
+  ok=pch_create();
+  /* remove all symbols that the prefix file declared (keep the predefined
+   * constants)
+   */
+  for (sym=glbtab.next; sym!=NULL; sym=sym->next)
+    if (sym->ident==iCONSTEXPR && (sym->usage & uPREDEF)!=0)
+      sym->usage|=uVISITED;
+  delete_symbols(&glbtab,0,TRUE,TRUE);
+  for (sym=glbtab.next; sym!=NULL; sym=sym->next)
+    sym->usage &= ~uVISITED;
+  if (!ok)
+    pch_delete();
+  return ok;
+}
+
+/*  cachekey
+ *
+ *  Builds the key for the cache of output files (see sccache.c) from all
+ *  settings that may change the output file, plus the main source files.
+ *  Returns FALSE if a source file cannot be read, or if the cache directory
+ *  cannot be created.
+ */
+static int cachekey(char *prefixname,char *codepage)
+{
+  int settings[15];
+  cell sizes[3];
+  symbol *sym;
+  char *name;
+  int i;
+
+  if (!cache_start(cachedir))
+    return FALSE;
+  settings[0]=sc_dataalign;
+  settings[1]=sc_asmfile;
+  settings[2]=sc_listing;
+  settings[3]=sc_expandonly;
+  settings[4]=pc_compress;
+  settings[5]=sc_debug;
+  settings[6]=pc_optimize;
+  settings[7]=skipinput;
+  settings[8]=pc_tabsize;
+  settings[9]=pc_matchedtabsize;
+  settings[10]=sc_needsemicolon;
+  settings[11]=sc_ctrlchar;
+  settings[12]=sc_packstr;
+  settings[13]=optproccall;
+  settings[14]=pc_overlays;
+  cache_keydata(settings,sizeof settings);
+  sizes[0]=pc_stksize;
+  sizes[1]=pc_amxlimit;
+  sizes[2]=pc_amxram;
+  cache_keydata(sizes,sizeof sizes);
+  cache_keystring(prefixname);
+  cache_keystring(codepage);
+  for (i=0; (name=get_path(i))!=NULL; i++)
+    cache_keystring(name);
+  /* constants that were set on the command line */
+  for (sym=glbtab.next; sym!=NULL; sym=sym->next) {
+    if (sym->ident==iCONSTEXPR) {
+      cache_keystring(sym->name);
+      cache_keydata(&sym->addr,sizeof sym->addr);
+    } /* if */
+  } /* for */
+  for (i=0; (name=get_sourcefile(i))!=NULL; i++)
+    if (!cache_keyfile(name))
+      return FALSE;
+  return TRUE;
+}
+#endif
+
 static int getclassspec(int initialtok,int *fpublic,int *fstatic,int *fstock,int *fconst)
 {
   int tok,err;
@@ -2080,7 +3373,7 @@ static void declglb(char *firstname,int firsttag,int fpublic,int fstatic,int fst
 
   assert(!fpublic || !fstatic);         /* may not both be set */
   insert_docstring_separator();         /* see comment in newfunc() */
-  filenum=fcurrent;                     /* save file number at the start of the declaration */
+  filenum=fscope;                       /* save file number at the start of the declaration */
   do {
     #if !defined PAWN_LIGHT
       pc_docstring_suspended=TRUE;      /* suspend attaching documentation to global/recent blocks */
@@ -2523,7 +3816,7 @@ static cell calc_arraysize(int dim[],int numdim,int cur)
 static cell adjust_indirectiontables(int dim[],int numdim,int cur,cell increment,
                                      int startlit,constvalue *lastdim,int *skipdim)
 {
-static int base;
+SC_VSTATIC int base;
   int d;
   cell accum;
 
@@ -3074,7 +4367,7 @@ static void decl_enum(int vclass)
     sym->x.tags.field=fieldtag;
     sym->dim.array.length=size;
     sym->dim.array.level=0;
-    sym->parent=enumsym;
+    setparent(sym,enumsym);
     /* add the constant to a separate list as well */
     if (enumroot!=NULL) {
       sym->usage |= uENUMFIELD;
@@ -3252,7 +4545,7 @@ SC_FUNC symbol *fetchfunc(char *name,int tag)
   if (pc_deprecate!=NULL) {
     assert(sym!=NULL);
     sym->flags|=flgDEPRICATED;
-    if (sc_status==statWRITE) {
+    if (sc_status==statWRITE || pch_recording()) {
       if (sym->documentation!=NULL) {
         free(sym->documentation);
         sym->documentation=NULL;
@@ -3410,8 +4703,7 @@ static int operatoradjust(int opertok,symbol *sym,char *opername,int resulttag)
         refer_symbol(sym,oldsym->refer[i]);
     delete_symbol(&glbtab,oldsym);
   } /* if */
-  strcpy(sym->name,tmpname);
-  sym->hash=namehash(sym->name);/* calculate new hash */
+  rename_symbol(sym,tmpname);   /* set new name and hash */
 
   /* operators should return a value, except the '~' operator */
   if (opertok!='~')
@@ -3655,7 +4947,7 @@ static void funcstub(int fnative)
   if (numdim>0) {
     assert(sym!=NULL);
     sub=addvariable(symbolname,0,iREFARRAY,sGLOBAL,tag,dim,numdim,idxtag);
-    sub->parent=sym;
+    setparent(sub,sym);
   } /* if */
 
   litidx=0;                     /* clear the literal pool */
@@ -3693,7 +4985,7 @@ static int newfunc(char *firstname,int firsttag,int fpublic,int fstatic,int stoc
   cidx=0;               /* just to avoid compiler warnings */
   glbdecl=0;
   assert(loctab.next==NULL);    /* local symbol table should be empty */
-  filenum=fcurrent;     /* save file number at the start of the declaration */
+  filenum=fscope;       /* save file number at the start of the declaration */
 
   if (firstname!=NULL) {
     assert(strlen(firstname)<=sNAMEMAX);
@@ -4263,13 +5555,8 @@ static void doarg(char *name,int ident,int offset,int tags[],int numtags,
 
 static int count_referrers(symbol *entry)
 {
-  int i,count;
-
-  count=0;
-  for (i=0; i<entry->numrefers; i++)
-    if (entry->refer[i]!=NULL)
-      count++;
-  return count;
+  assert(entry!=NULL);
+  return entry->refcount;
 }
 
 #if !defined PAWN_LIGHT
@@ -4436,6 +5723,66 @@ static void write_docstring(FILE *log,const char *string)
     fprintf(log,"\t\t\t%s\n",string);
 }
 
+/* write_depname() escapes the characters that are special to "make" */
+static void write_depname(FILE *fp,const char *name)
+{
+  while (*name!='\0') {
+    if (*name=='$')
+      fputc('$',fp);            /* "$$" for a single "$" */
+    else if (*name==' ' || *name=='#')
+      fputc('\\',fp);
+    fputc(*name,fp);
+    name++;
+  } /* while */
+}
+
+/*  make_depfile
+ *
+ *  Writes the main source files and all files that were read through
+ *  #include (plus the directories where a #tryinclude failed) as a rule in
+ *  the syntax of "make"; "ninja" reads the same format. Directories that do
+ *  not exist are left out, because "make" has no rule to create them. Each
+ *  dependency also gets an empty rule (like "gcc -MP"), so that removing an
+ *  include file does not stop the build.
+ */
+static void make_depfile(char *target)
+{
+  char filename[_MAX_PATH];
+  char *name;
+  FILE *fp;
+  int i;
+
+  if (strlen(depfname)>0) {
+    strcpy(filename,depfname);
+  } else {
+    strcpy(filename,target);
+    set_extension(filename,".d",TRUE);
+  } /* if */
+  if ((fp=fopen(filename,"w"))==NULL)
+    return;
+  write_depname(fp,target);
+  fputc(':',fp);
+  for (i=0; (name=get_sourcefile(i))!=NULL; i++) {
+    fputs(" \\\n  ",fp);
+    write_depname(fp,name);
+  } /* for */
+  for (i=0; (name=get_dependency(i))!=NULL; i++) {
+    if (access(name,0)!=0)
+      continue;
+    fputs(" \\\n  ",fp);
+    write_depname(fp,name);
+  } /* for */
+  fputc('\n',fp);
+  for (i=0; (name=get_dependency(i))!=NULL; i++) {
+    if (access(name,0)!=0)
+      continue;
+    fputc('\n',fp);
+    write_depname(fp,name);
+    fputs(":\n",fp);
+  } /* for */
+  fclose(fp);
+}
+
 static void make_report(symbol *root,FILE *log,char *sourcefile)
 {
   char symname[_MAX_PATH];
@@ -4754,47 +6101,71 @@ static void make_report(symbol *root,FILE *log,char *sourcefile)
  * the symbol. Now, if function "apple" is accessed by functions "banana" and
  * "citron", but neither function "banana" nor "citron" are used by anyone
  * else, then, by inference, function "apple" is not used either.
+ * The unused functions are kept on a worklist; when an unused function is
+ * taken from the list, it is removed as a referrer from all symbols that it
+ * uses (its "referto" list), and any function that thereby loses its last
+ * referrer is added to the worklist.
  */
+static int is_removable_function(symbol *sym)
+{
+  return sym->ident==iFUNCTN
+         && sym->parent==NULL
+         && (sym->usage & uNATIVE)==0
+         && (sym->usage & uPUBLIC)==0
+         && strcmp(sym->name,uMAINFUNC)!=0 && strcmp(sym->name,uENTRYFUNC)!=0 && strcmp(sym->name,uEXITFUNC)!=0;
+}
+
 static void reduce_referrers(symbol *root)
 {
-  int i,restart;
+  int i,count,top;
   symbol *sym,*ref;
+  symbol **worklist;
 
-  do {
-    restart=0;
-    for (sym=root->next; sym!=NULL; sym=sym->next) {
-      if (sym->parent!=NULL)
-        continue;                 /* hierarchical data type */
-      if (sym->ident==iFUNCTN
-          && (sym->usage & uNATIVE)==0
-          && (sym->usage & uPUBLIC)==0
-          && strcmp(sym->name,uMAINFUNC)!=0 && strcmp(sym->name,uENTRYFUNC)!=0 && strcmp(sym->name,uEXITFUNC)!=0
-          && count_referrers(sym)==0)
-      {
-        sym->usage&=~(uREAD | uWRITTEN);  /* erase usage bits if there is no referrer */
-        /* find all symbols that are referred by this symbol */
-        for (ref=root->next; ref!=NULL; ref=ref->next) {
-          if (ref->parent!=NULL)
-            continue;             /* hierarchical data type */
-          assert(ref->refer!=NULL);
-          for (i=0; i<ref->numrefers && ref->refer[i]!=sym; i++)
-            /* nothing */;
-          if (i<ref->numrefers) {
-            assert(ref->refer[i]==sym);
-            ref->refer[i]=NULL;
-            restart++;
-          } /* if */
-        } /* for */
-      } else if ((sym->ident==iVARIABLE || sym->ident==iARRAY)
-                 && (sym->usage & uPUBLIC)==0
-                 && sym->parent==NULL
-                 && count_referrers(sym)==0)
-      {
-        sym->usage&=~(uREAD | uWRITTEN);  /* erase usage bits if there is no referrer */
+  /* the worklist holds every function at most once */
+  count=0;
+  for (sym=root->next; sym!=NULL; sym=sym->next)
+    if (sym->ident==iFUNCTN)
+      count++;
+  if ((worklist=(symbol **)malloc((count+1)*sizeof(symbol*)))==NULL)
+    error(103);                 /* insufficient memory (fatal error) */
+
+  top=0;
+  for (sym=root->next; sym!=NULL; sym=sym->next) {
+    if (is_removable_function(sym) && count_referrers(sym)==0) {
+      sym->usage|=uVISITED;
+      worklist[top++]=sym;
+    } /* if */
+  } /* for */
+
+  while (top>0) {
+    sym=worklist[--top];
+    sym->usage&=~(uREAD | uWRITTEN);  /* erase usage bits if there is no referrer */
+    /* remove this function from the referrer lists of all symbols it uses;
+     * the "referto" list may hold stale entries, so check that the edge
+     * still exists before "ref" is looked at
+     */
+    for (i=0; i<sym->numreferto; i++) {
+      ref=sym->referto[i];
+      if (!is_referrer(ref,sym) || ref->parent!=NULL)
+        continue;                 /* stale entry, or hierarchical data type */
+      unrefer_symbol(ref,sym);
+      if ((ref->usage & uVISITED)==0 && is_removable_function(ref) && count_referrers(ref)==0) {
+        ref->usage|=uVISITED;
+        assert(top<count);
+        worklist[top++]=ref;
       } /* if */
     } /* for */
-    /* after removing a symbol, check whether more can be removed */
-  } while (restart>0);
+  } /* while */
+
+  for (sym=root->next; sym!=NULL; sym=sym->next) {
+    sym->usage&=~uVISITED;
+    if ((sym->ident==iVARIABLE || sym->ident==iARRAY)
+        && (sym->usage & uPUBLIC)==0
+        && sym->parent==NULL
+        && count_referrers(sym)==0)
+      sym->usage&=~(uREAD | uWRITTEN);  /* erase usage bits if there is no referrer */
+  } /* for */
+  free(worklist);
 }
 
 /* Generate the overlay information; this can be done once the first passes
@@ -4839,90 +6210,133 @@ static void gen_ovlinfo(symbol *root)
 }
 
 #if !defined PAWN_LIGHT
-static long max_stacksize_recurse(symbol **sourcesym,symbol *sym,long basesize,int *pubfuncparams,int *recursion)
+/* The worst-case stack use is the longest path through the call graph, where
+ * every function weighs as much as its own stack frame. The call graph is
+ * taken from the "referto" lists (the functions that a function calls). A
+ * recursive function (or a group of functions that call each other) forms a
+ * strongly connected component (SCC) in this graph; these components are
+ * found with Tarjan's algorithm. The components are completed in reverse
+ * topological order, so the longest path from each component can be computed
+ * as soon as the component is complete, and each function is visited once.
+ *
+ * I (mis-)use the "compound" field of the symbol structure for the index of
+ * the function in the arrays below, as this field is unused for functions.
+ */
+typedef struct s_stackinfo {
+  symbol **funcs;       /* all user-implemented functions */
+  int *index;           /* Tarjan's DFS index of each function, or -1 */
+  int *lowlink;         /* lowest index reachable from each function */
+  int *component;       /* SCC number of each function, or -1 */
+  int *stack;           /* stack of functions of the components being built */
+  int stacktop;
+  int counter;          /* next DFS index */
+  int numcomponents;
+  long *depth;          /* longest path (in cells) from each SCC */
+  char *recursive;      /* whether the SCC is recursive */
+  char *reachrecursion; /* whether a recursive SCC can be reached from the SCC */
+} stackinfo;
+
+static int stack_callee(symbol *func,int i)
 {
-  long size,maxsize;
-  int i,stkpos;
-
-  assert(sourcesym!=NULL);
-  assert(sym!=NULL);
-  assert(sym->ident==iFUNCTN);
-  assert((sym->usage & uNATIVE)==0);
-  assert(recursion!=NULL);
+  symbol *ref=func->referto[i];
+
+  /* the "referto" list may hold stale entries, check that the edge exists
+   * before looking at the symbol */
+  if (!is_referrer(ref,func) || ref->ident!=iFUNCTN || (ref->usage & uNATIVE)!=0)
+    return -1;
+  assert(ref->compound>0);
+  return ref->compound-1;
+}
 
-  maxsize=sym->x.stacksize;
-  for (i=0; i<sym->numrefers; i++) {
-    if (sym->refer[i]!=NULL) {
-      assert(sym->refer[i]->ident==iFUNCTN);
-      assert((sym->refer[i]->usage & uNATIVE)==0); /* a native function cannot refer to a user-function */
-      for (stkpos=0; sourcesym[stkpos]!=NULL; stkpos++) {
-        if (sym->refer[i]==sourcesym[stkpos]) {   /* recursion detection */
-          if ((sc_debug & sSYMBOLIC)!=0 || verbosity>=2) {
-            char symname[2*sNAMEMAX+16];/* allow space for user defined operators */
-            funcdisplayname(symname,sym->name);
-            errorset(sSETFILE,sym->fnumber);
-            errorset(sSETLINE,sym->lnumber);
-            error(237,symname);         /* recursive function */
-          } /* if */
-          *recursion=1;
-          goto break_recursion;         /* recursion was detected, quit loop */
-        } /* if */
-      } /* for */
-      /* add this symbol to the stack */
-      sourcesym[stkpos]=sym;
-      sourcesym[stkpos+1]=NULL;
-      /* check size of callee */
-      size=max_stacksize_recurse(sourcesym,sym->refer[i],sym->x.stacksize,pubfuncparams,recursion);
-      if (maxsize<size)
-        maxsize=size;
-      /* remove this symbol from the stack */
-      sourcesym[stkpos]=NULL;
+static void stack_strongconnect(stackinfo *si,int v)
+{
+  symbol *func=si->funcs[v];
+  int i,w,comp,members;
+  long maxdepth;
+
+  si->index[v]=si->lowlink[v]=si->counter++;
+  si->stack[si->stacktop++]=v;
+  for (i=0; i<func->numreferto; i++) {
+    if ((w=stack_callee(func,i))<0)
+      continue;
+    if (si->index[w]<0) {
+      stack_strongconnect(si,w);
+      if (si->lowlink[v]>si->lowlink[w])
+        si->lowlink[v]=si->lowlink[w];
+    } else if (si->component[w]<0 && si->lowlink[v]>si->index[w]) {
+      si->lowlink[v]=si->index[w];        /* "w" is on the stack */
     } /* if */
   } /* for */
-  break_recursion:
+  if (si->lowlink[v]!=si->index[v])
+    return;
 
-  if ((sym->usage & uPUBLIC)!=0) {
-    /* Find out how many parameters a public function has, then see if this
-     * is bigger than some maximum
-     */
-    arginfo *arg=sym->dim.arglist;
-    int count=0;
-    assert(arg!=0);
-    while (arg->ident!=0) {
-      count++;
-      arg++;
-    } /* while */
-    assert(pubfuncparams!=0);
-    if (count>*pubfuncparams)
-      *pubfuncparams=count;
-  } /* if */
+  /* "v" is the root of a component: pop its members */
+  comp=si->numcomponents++;
+  si->depth[comp]=0;
+  members=0;
+  do {
+    w=si->stack[--si->stacktop];
+    si->component[w]=comp;
+    si->depth[comp]+=si->funcs[w]->x.stacksize;
+    members++;
+  } while (w!=v);
+  si->recursive[comp]=(char)(members>1 || is_referrer(func,func));
+  si->reachrecursion[comp]=si->recursive[comp];
+
+  /* add the longest path from any callee outside the component; these
+   * components were all completed earlier */
+  maxdepth=0;
+  for (w=si->stacktop; w<si->stacktop+members; w++) {
+    symbol *member=si->funcs[si->stack[w]];
+    for (i=0; i<member->numreferto; i++) {
+      int callee=stack_callee(member,i);
+      if (callee<0 || si->component[callee]==comp)
+        continue;
+      assert(si->component[callee]>=0 && si->component[callee]<comp);
+      if (maxdepth<si->depth[si->component[callee]])
+        maxdepth=si->depth[si->component[callee]];
+      if (si->reachrecursion[si->component[callee]])
+        si->reachrecursion[comp]=1;
+    } /* for */
+  } /* for */
+  si->depth[comp]+=maxdepth;
+}
 
-  errorset(sEXPRRELEASE,0); /* clear error data */
-  errorset(sRESET,0);
+static int count_params(symbol *sym)
+{
+  arginfo *arg=sym->dim.arglist;
+  int count=0;
 
-  return maxsize+basesize;
+  assert(arg!=NULL);
+  while (arg->ident!=0) {
+    count++;
+    arg++;
+  } /* while */
+  return count;
 }
 
-static long max_stacksize(symbol *root,int *recursion)
+/*  stack_analysis
+ *
+ *  Returns the estimated stack requirements of the script, in cells. On
+ *  recursion, the estimate is not reliable; "recursion" is then set and
+ *  (on verbose output) a warning is given for every recursive component.
+ *  If "report" is set, the estimated stack use per public function (and
+ *  for main()) is printed instead of the warnings.
+ *
+ *  Note that the stack is shared with the heap. A host application
+ *  may "eat" cells from the heap as well, through amx_Allot(). The
+ *  stack requirements are thus only an estimate.
+ */
+static long stack_analysis(symbol *root,int *recursion,int report)
 {
-  /* Loop over all non-native functions. For each function, loop
-   * over all of its referrers, accumulating the stack requirements.
-   * Detect (indirect) recursion with a "mark-and-sweep" algorithm.
-   * I (mis-)use the "compound" field of the symbol structure for
-   * the marker, as this field is unused for functions.
-   *
-   * Note that the stack is shared with the heap. A host application
-   * may "eat" cells from the heap as well, through amx_Allot(). The
-   * stack requirements are thus only an estimate.
-   */
-  long size,maxsize;
-  int maxparams,numfunctions;
+  stackinfo si;
+  long maxsize;
+  int maxparams,numfunctions,i;
   symbol *sym;
-  symbol **symstack;
 
   assert(root!=NULL);
   assert(recursion!=NULL);
-  /* count number of functions (for allocating the stack for recursion detection) */
+  /* count number of functions and number them */
   numfunctions=0;
   for (sym=root->next; sym!=NULL; sym=sym->next) {
     if (sym->ident==iFUNCTN) {
@@ -4931,34 +6345,97 @@ static long max_stacksize(symbol *root,int *recursion)
         numfunctions++;
     } /* if */
   } /* if */
-  /* allocate function symbol stack */
-  symstack=(symbol **)malloc((numfunctions+1)*sizeof(symbol*));
-  if (symstack==NULL)
+  memset(&si,0,sizeof si);
+  si.funcs=(symbol **)malloc((numfunctions+1)*sizeof(symbol*));
+  si.index=(int *)malloc((numfunctions+1)*sizeof(int));
+  si.lowlink=(int *)malloc((numfunctions+1)*sizeof(int));
+  si.component=(int *)malloc((numfunctions+1)*sizeof(int));
+  si.stack=(int *)malloc((numfunctions+1)*sizeof(int));
+  si.depth=(long *)malloc((numfunctions+1)*sizeof(long));
+  si.recursive=(char *)malloc((numfunctions+1)*sizeof(char));
+  si.reachrecursion=(char *)malloc((numfunctions+1)*sizeof(char));
+  if (si.funcs==NULL || si.index==NULL || si.lowlink==NULL || si.component==NULL
+      || si.stack==NULL || si.depth==NULL || si.recursive==NULL || si.reachrecursion==NULL)
     error(103);         /* insufficient memory (fatal error) */
-  memset(symstack,0,(numfunctions+1)*sizeof(symbol*));
+  i=0;
+  for (sym=root->next; sym!=NULL; sym=sym->next) {
+    if (sym->ident==iFUNCTN && (sym->usage & uNATIVE)==0) {
+      si.funcs[i]=sym;
+      si.index[i]=si.component[i]=-1;
+      sym->compound=++i;        /* index + 1, so that 0 remains invalid */
+    } /* if */
+  } /* for */
+
+  for (i=0; i<numfunctions; i++)
+    if (si.index[i]<0)
+      stack_strongconnect(&si,i);
 
   maxsize=0;
   maxparams=0;
   *recursion=0;         /* assume no recursion */
-  for (sym=root->next; sym!=NULL; sym=sym->next) {
-    /* drop out if this is not a user-implemented function */
-    if (sym->ident!=iFUNCTN || (sym->usage & uNATIVE)!=0)
-      continue;
-    /* accumulate stack size for this symbol */
-    symstack[0]=sym;
-    assert(symstack[1]==NULL);
-    size=max_stacksize_recurse(symstack,sym,0L,&maxparams,recursion);
-    assert(size>=0);
-    if (maxsize<size)
-      maxsize=size;
+  for (i=0; i<numfunctions; i++) {
+    int comp=si.component[i];
+    sym=si.funcs[i];
+    sym->compound=0;
+    if (maxsize<si.depth[comp])
+      maxsize=si.depth[comp];
+    if ((sym->usage & uPUBLIC)!=0 || report && strcmp(sym->name,uMAINFUNC)==0) {
+      /* find out how many parameters a public function has, then see if this
+       * is bigger than some maximum */
+      int count=count_params(sym);
+      if ((sym->usage & uPUBLIC)!=0 && maxparams<count)
+        maxparams=count;
+      if (report) {
+        char symname[2*sNAMEMAX+16];  /* allow space for user defined operators */
+        funcdisplayname(symname,sym->name);
+        if (si.reachrecursion[comp])
+          pc_printf("  %-32s unknown, due to recursion\n",symname);
+        else
+          pc_printf("  %-32s %8ld cells\n",symname,si.depth[comp]+1+(count+1));
+      } /* if */
+    } /* if */
+    if (si.recursive[comp]) {
+      /* report every recursive component once, on the first of its functions */
+      *recursion=1;
+      if (!report && ((sc_debug & sSYMBOLIC)!=0 || verbosity>=2)) {
+        char symname[2*sNAMEMAX+16];  /* allow space for user defined operators */
+        funcdisplayname(symname,sym->name);
+        errorset(sSETFILE,sym->fnumber);
+        errorset(sSETLINE,sym->lnumber);
+        error(237,symname);         /* recursive function */
+      } /* if */
+      si.recursive[comp]=0;
+    } /* if */
   } /* for */
+  errorset(sEXPRRELEASE,0); /* clear error data */
+  errorset(sRESET,0);
 
-  free((void*)symstack);
+  free(si.funcs);
+  free(si.index);
+  free(si.lowlink);
+  free(si.component);
+  free(si.stack);
+  free(si.depth);
+  free(si.recursive);
+  free(si.reachrecursion);
   maxsize++;                  /* +1 because a zero cell is always pushed on top
                                * of the stack to catch stack overwrites */
   return maxsize+(maxparams+1);/* +1 because # of parameters is always pushed on entry */
 }
 
+static long max_stacksize(symbol *root,int *recursion)
+{
+  return stack_analysis(root,recursion,FALSE);
+}
+
+static void report_stacksizes(symbol *root)
+{
+  int recursion;
+
+  pc_printf("Stack use per public function:\n");
+  stack_analysis(root,&recursion,TRUE);
+}
+
 static long max_overlaysize(symbol *root)
 {
   symbol *sym;
@@ -6134,7 +7611,7 @@ static void doreturn(void)
         for (argcount=0; curfunc->dim.arglist[argcount].ident!=0; argcount++)
           /* nothing */;
         sub=addvariable(curfunc->name,(argcount+3)*sizeof(cell),iREFARRAY,sGLOBAL,curfunc->tag,dim,numdim,idxtag);
-        sub->parent=curfunc;
+        setparent(sub,curfunc);
       } /* if */
       /* get the hidden parameter, copy the array (the array is on the heap;
        * it stays on the heap for the moment, and it is removed -usually- at
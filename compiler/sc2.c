@@ -39,9 +39,11 @@
 #define ISPACKED        0x4
 static cell litchar(const unsigned char **lptr,int flags);
 static symbol *find_symbol(const symbol *root,const char *name,int fnumber,int automaton,int *cmptag);
+static void unrefer_all(symbol *sym);
 
 static void substallpatterns(unsigned char *line,int buffersize);
 static int match(char *st,int end);
+static void init_tokenchains(void);
 static int alpha(unsigned char c);
 
 #define SKIPMODE      1 /* bit field in "#if" stack */
@@ -49,12 +51,16 @@ static int alpha(unsigned char c);
 #define HANDLED_ELSE  4 /* bit field in "#if" stack */
 #define SKIPPING      (skiplevel>0 && (ifstack[skiplevel-1] & SKIPMODE)==SKIPMODE)
 
-static short icomment;  /* currently in multiline comment? */
-static char ifstack[sCOMP_STACK]; /* "#if" stack */
-static short iflevel;   /* nesting level if #if/#else/#endif */
-static short skiplevel; /* level at which we started skipping (including nested #if .. #endif) */
+SC_VSTATIC short icomment;  /* currently in multiline comment? */
+SC_VSTATIC symbol *line_sym=NULL; /* the "__line" constant, cleared when it is deleted */
+#if !defined PAWN_LIGHT
+  SC_VSTATIC int prev_singleline=FALSE; /* previous line held a "///" comment */
+#endif
+SC_VSTATIC char ifstack[sCOMP_STACK]; /* "#if" stack */
+SC_VSTATIC short iflevel;   /* nesting level if #if/#else/#endif */
+SC_VSTATIC short skiplevel; /* level at which we started skipping (including nested #if .. #endif) */
 static unsigned char term_expr[] = "";
-static int listline=-1; /* "current line" for the list file */
+SC_VSTATIC int listline=-1; /* "current line" for the list file */
 
 
 /*  pushstk & popstk
@@ -70,8 +76,8 @@ static int listline=-1; /* "current line" for the list file */
  *  Global references: stack,stkidx,stktop (private to pushstk(), popstk()
  *                     and clearstk())
  */
-static stkitem *stack=NULL;
-static int stkidx=0,stktop=0;
+SC_VSTATIC stkitem *stack=NULL;
+SC_VSTATIC int stkidx=0,stktop=0;
 
 SC_FUNC void pushstk(stkitem val)
 {
@@ -119,26 +125,113 @@ SC_FUNC void clearstk(void)
   assert(stktop==0);
 }
 
+/* The include file resolution cache records, for every (qualified) name that
+ * plungequalifiedfile() looked up, which variant of the name exists: the name
+ * itself, the name with one of the default extensions, or none at all. With
+ * several include directories, a single #include would otherwise cause a
+ * series of failing attempts to open a file, and this would be repeated on
+ * every pass. The cache is kept for the lifetime of the process.
+ */
+typedef struct s_pathcache {
+  struct s_pathcache *next;
+  char *name;           /* path and name, without an appended extension */
+  int variant;          /* -1 = not found, 0 = name itself, else extension index + 1 */
+} pathcache;
+
+SC_VSTATIC pathcache *pathhash[sPATHHASH];
+
+static pathcache *find_pathcache(const char *name)
+{
+  pathcache *entry;
+
+  for (entry=pathhash[namehash(name) & (sPATHHASH-1)]; entry!=NULL; entry=entry->next)
+    if (strcmp(entry->name,name)==0)
+      return entry;
+  return NULL;
+}
+
+static void insert_pathcache(const char *name,int variant)
+{
+  pathcache *entry;
+  int idx;
+
+  if ((entry=find_pathcache(name))!=NULL) {
+    entry->variant=variant;
+    return;
+  } /* if */
+  if ((entry=(pathcache*)malloc(sizeof(pathcache)))==NULL)
+    return;             /* failing to cache the result is not an error */
+  if ((entry->name=duplicatestring(name))==NULL) {
+    free(entry);
+    return;
+  } /* if */
+  entry->variant=variant;
+  idx=namehash(name) & (sPATHHASH-1);
+  entry->next=pathhash[idx];
+  pathhash[idx]=entry;
+}
+
+SC_FUNC void delete_pathcache(void)
+{
+  int idx;
+
+  for (idx=0; idx<sPATHHASH; idx++) {
+    while (pathhash[idx]!=NULL) {
+      pathcache *next=pathhash[idx]->next;
+      free(pathhash[idx]->name);
+      free(pathhash[idx]);
+      pathhash[idx]=next;
+    } /* while */
+  } /* for */
+}
+
 SC_FUNC int plungequalifiedfile(char *name)
 {
 static char *extensions[] = { ".inc", ".p", ".pawn" };
   FILE *fp;
   char *ext;
-  int ext_idx;
-
-  ext_idx=0;
-  do {
+  int ext_idx,variant;
+  pathcache *cached;
+
+  fp=NULL;
+  ext=strchr(name,'\0');
+  if ((cached=find_pathcache(name))!=NULL) {
+    if (cached->variant<0)
+      return FALSE;             /* known not to exist */
+    if (cached->variant>0)
+      strcpy(ext,extensions[cached->variant-1]);
     fp=(FILE*)pc_opensrc(name);
-    ext=strchr(name,'\0');      /* save position */
-    if (fp==NULL) {
-      /* try to append an extension */
-      strcpy(ext,extensions[ext_idx]);
+    if (fp==NULL)
+      *ext='\0';               /* file has disappeared, search again */
+  } /* if */
+  if (fp==NULL) {
+    ext_idx=0;
+    variant=-1;
+    do {
       fp=(FILE*)pc_opensrc(name);
-      if (fp==NULL)
-        *ext='\0';              /* on failure, restore filename */
+      if (fp!=NULL) {
+        variant=0;
+      } else {
+        /* try to append an extension */
+        strcpy(ext,extensions[ext_idx]);
+        fp=(FILE*)pc_opensrc(name);
+        if (fp==NULL)
+          *ext='\0';           /* on failure, restore filename */
+        else
+          variant=ext_idx+1;
+      } /* if */
+      ext_idx++;
+    } while (fp==NULL && ext_idx<(sizeof extensions / sizeof extensions[0]));
+    if (variant>0) {
+      /* the name in the cache is without the extension */
+      char c=*ext;
+      *ext='\0';
+      insert_pathcache(name,variant);
+      *ext=c;
+    } else {
+      insert_pathcache(name,variant);
     } /* if */
-    ext_idx++;
-  } while (fp==NULL && ext_idx<(sizeof extensions / sizeof extensions[0]));
+  } /* if */
   if (fp==NULL) {
     *ext='\0';                  /* restore filename */
     return FALSE;
@@ -152,6 +245,7 @@ static char *extensions[] = { ".inc", ".p", ".pawn" };
   PUSHSTK_I(sc_is_utf8);
   PUSHSTK_I(icomment);
   PUSHSTK_I(fcurrent);
+  PUSHSTK_I(fscope);
   PUSHSTK_I(fline);
   inpfname=duplicatestring(name);/* set name of include file */
   if (inpfname==NULL)
@@ -160,10 +254,13 @@ static char *extensions[] = { ".inc", ".p", ".pawn" };
   fnumber++;
   fline=0;                      /* set current line number to 0 */
   fcurrent=fnumber;
+  fscope=fnumber;
   icomment=0;                   /* not in a comment */
   insert_dbgfile(inpfname);     /* attach to debug information */
   insert_inputfile(inpfname);   /* save for the error system */
   assert(sc_status==statFIRST || strcmp(get_inputfile(fcurrent),inpfname)==0);
+  pch_filepush(inpfname);       /* log for a precompiled prefix */
+  insert_dependency(inpfname);  /* for the dependency file */
   setfiledirect(inpfname);      /* (optionally) set in the list file */
   listline=-1;                  /* force a #line directive when changing the file */
   sc_is_utf8=(short)scan_utf8(inpf,name);
@@ -210,6 +307,41 @@ SC_FUNC int plungefile(char *name,int try_currentpath,int try_includepaths)
   return result;
 }
 
+/*  watchfile
+ *
+ *  For a file that plungefile() could not find, this adds the directories
+ *  where it looked to the dependency list: a build tool then rebuilds when a
+ *  file is added to one of these directories.
+ */
+SC_FUNC void watchfile(char *name,int try_currentpath,int try_includepaths)
+{
+  char path[_MAX_PATH];
+  char *ptr;
+  int i;
+
+  if (try_currentpath) {
+    if ((ptr=strrchr(inpfname,DIRSEP_CHAR))!=NULL && ptr!=inpfname)
+      strlcpy(path,inpfname,(int)(ptr-inpfname)+1);
+    else if (ptr!=NULL)
+      strlcpy(path,inpfname,2); /* root directory */
+    else
+      strcpy(path,".");
+    insert_dependency(path);
+    pch_filewatch(path);
+  } /* if */
+  if (try_includepaths && name[0]!=DIRSEP_CHAR) {
+    for (i=0; (ptr=get_path(i))!=NULL; i++) {
+      size_t len;
+      strlcpy(path,ptr,sizeof path);
+      len=strlen(path);
+      if (len>1 && path[len-1]==DIRSEP_CHAR)
+        path[len-1]='\0';      /* strip the trailing separator */
+      insert_dependency(path);
+      pch_filewatch(path);
+    } /* for */
+  } /* if */
+}
+
 static void check_empty(const unsigned char *lptr)
 {
   /* verifies that the string contains only whitespace */
@@ -283,7 +415,7 @@ static void doinclude(int silent)
      */
     strlwr(symname);
   #endif
-  if (find_symbol(&glbtab,symname,fcurrent,-1,NULL)==NULL) {
+  if (find_symbol(&glbtab,symname,fscope,-1,NULL)==NULL) {
     /* constant is not present, so this file has not been included yet */
 
     /* Include files between "..." or without quotes are read from the same
@@ -296,7 +428,77 @@ static void doinclude(int silent)
       add_constant(symname,1,sGLOBAL,0,FALSE);
     else if (!silent)
       error(100,name);            /* cannot read from ... (fatal error) */
+    else
+      watchfile(name,(c!='>'),TRUE);  /* #tryinclude: the file may appear later */
+  } /* if */
+}
+
+/*  is_inactiveline
+ *
+ *  Checks whether a line in a section that is skipped by #if ... #endif can be
+ *  dropped without handing it to the preprocessor: it is a complete line (with
+ *  a '\n'), its first non-blank character is not a '#', it contains no '/'
+ *  (so it cannot start a comment) and it does not end with a '\' (line
+ *  continuation).
+ */
+static int is_inactiveline(const unsigned char *line)
+{
+  const unsigned char *ptr;
+  size_t len;
+
+  len=strlen((const char*)line);
+  if (len==0 || line[len-1]!='\n')
+    return FALSE;
+  for (ptr=line; *ptr<=' ' && *ptr!='\0'; ptr++)
+    /* nothing */;
+  if (*ptr=='#')
+    return FALSE;
+  if (memchr(line,'/',len)!=NULL)
+    return FALSE;
+  for (ptr=line+len-1; ptr>line && *ptr<=' '; ptr--)
+    /* nothing */;
+  return *ptr!='\\';
+}
+
+/*  nextsource
+ *
+ *  When several source files are given, these are read as if they were a
+ *  single file: at the end of one source file, the next one is opened at the
+ *  level of the main file (like it would follow a "#file" and "#line 0" in a
+ *  concatenation of the files). Each source file gets its own file number, for
+ *  the messages and the debug information, but the scope for "static" symbols
+ *  (fscope) stays that of the first source file. The function returns FALSE
+ *  if there is no next source file.
+ *
+ *  Global references: inpf,inpf_index,inpfname,fline,fnumber,fcurrent (altered)
+ */
+static int nextsource(void)
+{
+  char *name;
+  FILE *fp;
+
+  if ((name=get_sourcefile(inpf_index+1))==NULL)
+    return FALSE;
+  fp=(FILE*)pc_opensrc(name);
+  free(inpfname);
+  inpfname=duplicatestring(name);
+  if (inpfname==NULL)
+    error(103);                 /* insufficient memory */
+  fline=0;
+  if (fp==NULL) {
+    if (inpf!=inpf_org)
+      inpf=NULL;                /* the active file is already closed */
+    error(100,name);            /* cannot read from file (fatal error) */
   } /* if */
+  inpf_index++;
+  inpf=fp;
+  fnumber++;
+  fcurrent=fnumber;
+  insert_dbgfile(inpfname);     /* attach to debug information */
+  insert_inputfile(inpfname);   /* save for the error system */
+  setfiledirect(inpfname);      /* (optionally) set in the list file */
+  listline=-1;                  /* force a #line directive when changing the file */
+  return TRUE;
 }
 
 /*  readline
@@ -310,8 +512,9 @@ static void doinclude(int silent)
  */
 static void readline(unsigned char *line)
 {
-  int i,num,cont;
+  int i,num,len,cont;
   unsigned char *ptr;
+  char *src;
 
   if (lptr==term_expr)
     return;
@@ -324,7 +527,12 @@ static void readline(unsigned char *line)
       if (inpf!=NULL && inpf!=inpf_org)
         pc_closesrc(inpf);
       i=POPSTK_I();
-      if (i==-1) {        /* All's done; popstk() returns "stack is empty" */
+      if (i==-1 && (inpf==NULL || !nextsource())) {
+        /* All's done; popstk() returns "stack is empty" and there is no
+         * further source file
+         */
+        if (inpf!=inpf_org)
+          inpf=NULL;      /* the last source file was closed above */
         freading=FALSE;
         *line='\0';
         /* when there is nothing more to read, the #if/#else stack should
@@ -337,42 +545,71 @@ static void readline(unsigned char *line)
           error(1,"*/","-end of file-");
         return;
       } /* if */
-      fline=i;
-      fcurrent=(short)POPSTK_I();
-      icomment=(short)POPSTK_I();
-      sc_is_utf8=(short)POPSTK_I();
-      iflevel=(short)POPSTK_I();
-      skiplevel=iflevel;        /* this condition held before including the file */
-      assert(!SKIPPING);        /* idem ditto */
-      curlibrary=(constvalue *)POPSTK_P();
-      free(inpfname);           /* return memory allocated for the include file name */
-      inpfname=(char *)POPSTK_P();
-      inpf=(FILE *)POPSTK_P();
-      //??? if sc_status==statSKIP, we should first finish the function to reset code_idx
-      insert_dbgfile(inpfname);
-      setfiledirect(inpfname);
-      assert(sc_status==statFIRST || strcmp(get_inputfile(fcurrent),inpfname)==0);
-      listline=-1;              /* force a #line directive when changing the file */
+      if (i!=-1) {
+        fline=i;
+        fscope=(short)POPSTK_I();
+        fcurrent=(short)POPSTK_I();
+        icomment=(short)POPSTK_I();
+        sc_is_utf8=(short)POPSTK_I();
+        iflevel=(short)POPSTK_I();
+        skiplevel=iflevel;      /* this condition held before including the file */
+        assert(!SKIPPING);      /* idem ditto */
+        curlibrary=(constvalue *)POPSTK_P();
+        free(inpfname);         /* return memory allocated for the include file name */
+        inpfname=(char *)POPSTK_P();
+        inpf=(FILE *)POPSTK_P();
+        //??? if sc_status==statSKIP, we should first finish the function to reset code_idx
+        insert_dbgfile(inpfname);
+        pch_filepop(inpfname);
+        setfiledirect(inpfname);
+        assert(sc_status==statFIRST || strcmp(get_inputfile(fcurrent),inpfname)==0);
+        listline=-1;            /* force a #line directive when changing the file */
+      } /* if */
     } /* if */
 
-    if (pc_readsrc(inpf,line,num)==NULL) {
+    /* when only the prefix file is parsed (for a precompiled prefix), there
+     * is no main file to return to
+     */
+    src=(inpf!=NULL) ? pc_readsrc(inpf,line,num) : NULL;
+    if (src!=NULL && SKIPPING && !cont && icomment==0 && !sc_listing) {
+      /* fast path for an inactive #if section: lines that cannot hold a
+       * directive, start a comment or continue on the next line need no
+       * further processing
+       */
+      if (is_inactiveline(line)) {
+        do {
+          fline+=1;
+          src=pc_readsrc(inpf,line,num);
+        } while (src!=NULL && is_inactiveline(line));
+        #if !defined PAWN_LIGHT
+          prev_singleline=FALSE;/* as if stripcom() saw the skipped lines */
+        #endif
+      } /* if */
+    } /* if */
+    if (src==NULL) {
       *line='\0';     /* delete line */
       cont=FALSE;
     } else {
+      len=strlen((char*)line);
       /* check whether to erase leading spaces */
       if (cont) {
         unsigned char *ptr=line;
         while (*ptr<=' ' && *ptr!='\0')
           ptr++;
-        if (ptr!=line)
-          memmove(line,ptr,strlen((char*)ptr)+1);
+        if (ptr!=line) {
+          len-=(int)(ptr-line);
+          memmove(line,ptr,len+1);
+        } /* if */
       } /* if */
       cont=FALSE;
-      /* check whether a full line was read */
-      if (strchr((char*)line,'\n')==NULL && !pc_eofsrc(inpf))
+      /* check whether a full line was read; a '\n' can only be the last
+       * character of the line that was read
+       */
+      ptr=(len>0 && line[len-1]=='\n') ? line+len-1 : NULL;
+      if (ptr==NULL && !pc_eofsrc(inpf))
         error(75);      /* line too long */
       /* check if the next line must be concatenated to this line */
-      if ((ptr=(unsigned char*)strchr((char*)line,'\n'))==NULL)
+      if (ptr==NULL)
         ptr=(unsigned char*)strchr((char*)line,'\r');
       if (ptr!=NULL && ptr>line) {
         assert(*(ptr+1)=='\0'); /* '\n' or '\r' should be last in the string */
@@ -385,13 +622,17 @@ static void readline(unsigned char *line)
            */
           *ptr++='\a';
           *ptr='\0';    /* erase '\n' (and any trailing whitespace) */
+          len=(int)(ptr-line);
         } /* if */
       } /* if */
-      num-=strlen((char*)line);
-      line+=strlen((char*)line);
+      num-=len;
+      line+=len;
     } /* if */
     fline+=1;
-    add_constant("__line",fline,sGLOBAL,0,TRUE);
+    if (line_sym!=NULL)
+      line_sym->addr=fline;
+    else
+      line_sym=add_constant("__line",fline,sGLOBAL,0,TRUE);
   } while (num>=0 && cont);
 }
 
@@ -417,7 +658,6 @@ static void stripcom(unsigned char *line)
     char comment[COMMENT_LIMIT+COMMENT_MARGIN];
     int commentidx=0;
     int skipstar=TRUE;
-    static int prev_singleline=FALSE;
     int singleline=prev_singleline;
 
     prev_singleline=FALSE;  /* preset */
@@ -569,43 +809,6 @@ static int btoi(cell *val,const unsigned char *curptr)
     return (int)(ptr-curptr);
 }
 
-/*  dtoi
- *
- *  Attempts to interpret a numeric symbol as a decimal value. On success
- *  it returns the number of characters processed and the value is stored in
- *  "val". Otherwise it returns 0 and "val" is garbage.
- */
-static int dtoi(cell *val,const unsigned char *curptr)
-{
-  const unsigned char *ptr;
-  unsigned digitsep=UINT_MAX; /* thousands separator */
-
-  *val=0;
-  ptr=curptr;
-  if (!isdigit(*ptr))   /* should start with digit */
-    return 0;
-  while (isdigit(*ptr) || *ptr=='\'') {
-    if (*ptr=='\'') {
-      if (digitsep!=0 && digitsep<INT_MAX)
-        return 0;       /* invalid numeric format */
-      digitsep=3;
-    } else {
-      *val=(*val*10)+(*ptr-'0');
-      digitsep--;
-    } /* if */
-    ptr++;
-  } /* while */
-  if (digitsep==3)
-    ptr--;
-  else if (digitsep!=0 && digitsep<INT_MAX)
-    return 0;           /* invalid numeric format */
-  if (alphanum(*ptr))   /* number must be delimited by non-alphanumerical */
-    return 0;
-  if (*ptr=='.' && isdigit(*(ptr+1)))
-    return 0;           /* but a fractional part must not be present */
-  return (int)(ptr-curptr);
-}
-
 /*  htoi
  *
  *  Attempts to interpret a numeric symbol as a hexadecimal value. On
@@ -666,44 +869,24 @@ static int htoi(cell *val,const unsigned char *curptr)
  *     is not a valid number, you should write "2.0e3"
  *  o  at least one digit must follow the period; "6." is not a valid number,
  *     you should write "6.0"
+ *
+ *  This function is called by number() when the integral part has been read
+ *  and a period plus a digit follows; "ptr" points to the period, "fnum" is
+ *  the integral part and "inum" is the integral part as an integer.
  */
-static int ftoi(cell *val,const unsigned char *curptr)
+static int ftoi(cell *val,const unsigned char *curptr,const unsigned char *ptr,
+                double fnum,unsigned long inum)
 {
-  const unsigned char *ptr;
-  double fnum,ffrac,fmult;
+  double ffrac,fmult;
   unsigned long dnum,dbase;
   int i, ignore;
-  unsigned digitsep=UINT_MAX; /* thousands separator */
 
-  if (!isdigit(*curptr))      /* should start with digit */
-    return 0;
   assert(rational_digits>=0 && rational_digits<9);
   for (i=0,dbase=1; i<rational_digits; i++)
     dbase*=10;
-  fnum=0.0;
-  dnum=0L;
-  ptr=curptr;
-  while (isdigit(*ptr) || *ptr=='\'') {
-    if (*ptr=='\'') {
-      if (digitsep!=0 && digitsep<INT_MAX)
-        return 0;       /* invalid numeric format */
-      digitsep=3;
-    } else {
-      fnum=(fnum*10.0)+(*ptr-'0');
-      dnum=(dnum*10L)+(*ptr-'0')*dbase;
-      digitsep--;
-    } /* if */
-    ptr++;
-  } /* while */
-  if (digitsep==3)
-    ptr--;
-  else if (digitsep!=0 && digitsep<INT_MAX)
-    return 0;           /* invalid numeric format */
-  if (*ptr!='.')
-    return 0;           /* there must be a period */
-  ptr++;
-  if (!isdigit(*ptr))   /* there must be at least one digit after the dot */
-    return 0;
+  dnum=inum*dbase;
+  assert(*ptr=='.' && isdigit(*(ptr+1)));
+  ptr++;                /* skip the period */
   ffrac=0.0;
   fmult=1.0;
   ignore=FALSE;
@@ -792,30 +975,69 @@ static int ftoi(cell *val,const unsigned char *curptr)
 
 /*  number
  *
- *  Reads in a number (binary, decimal or hexadecimal). It returns the number
- *  of characters processed or 0 if the symbol couldn't be interpreted as a
- *  number (in this case the argument "val" remains unchanged). This routine
- *  relies on the 'early dropout' implementation of the logical or (||)
- *  operator.
+ *  Reads in a number (binary, decimal, hexadecimal or rational) in a single
+ *  scan. It returns the number of characters processed or 0 if the symbol
+ *  couldn't be interpreted as a number (in this case the argument "val"
+ *  remains unchanged). On success, "rational" is set to whether the number
+ *  is a rational number.
  *
  *  Note: the routine doesn't check for a sign (+ or -). The - is checked
  *        for at "hier2()" (in fact, it is viewed as an operator, not as a
  *        sign) and the + is invalid (as in K&R C, and unlike ANSI C).
  */
-static int number(cell *val,const unsigned char *curptr)
+static int number(cell *val,const unsigned char *curptr,int *rational)
 {
-  int i;
+  const unsigned char *ptr;
+  unsigned digitsep=UINT_MAX; /* thousands separator */
   cell value;
+  double fnum;
+  unsigned long inum;
+  int i;
 
-  if ((i=btoi(&value,curptr))!=0      /* binary? */
-      || (i=htoi(&value,curptr))!=0   /* hexadecimal? */
-      || (i=dtoi(&value,curptr))!=0)  /* decimal? */
-  {
-    *val=value;
+  if (!isdigit(*curptr))        /* should start with digit */
+    return 0;
+  *rational=FALSE;
+  if (*curptr=='0' && *(curptr+1)=='b') {
+    if ((i=btoi(&value,curptr))!=0)
+      *val=value;
     return i;
-  } else {
-    return 0;                         /* else not a number */
   } /* if */
+  if (*curptr=='0' && *(curptr+1)=='x') {
+    if ((i=htoi(&value,curptr))!=0)
+      *val=value;
+    return i;
+  } /* if */
+
+  /* decimal or rational: read the integral part */
+  value=0;
+  fnum=0.0;
+  inum=0L;
+  ptr=curptr;
+  while (isdigit(*ptr) || *ptr=='\'') {
+    if (*ptr=='\'') {
+      if (digitsep!=0 && digitsep<INT_MAX)
+        return 0;       /* invalid numeric format */
+      digitsep=3;
+    } else {
+      value=(value*10)+(*ptr-'0');
+      fnum=(fnum*10.0)+(*ptr-'0');
+      inum=(inum*10L)+(*ptr-'0');
+      digitsep--;
+    } /* if */
+    ptr++;
+  } /* while */
+  if (digitsep==3)
+    ptr--;
+  else if (digitsep!=0 && digitsep<INT_MAX)
+    return 0;           /* invalid numeric format */
+  if (*ptr=='.' && isdigit(*(ptr+1))) {
+    *rational=TRUE;
+    return ftoi(val,curptr,ptr,fnum,inum);
+  } /* if */
+  if (alphanum(*ptr))   /* number must be delimited by non-alphanumerical */
+    return 0;
+  *val=value;
+  return (int)(ptr-curptr);
 }
 
 static void chrcat(char *str,char chr)
@@ -1459,9 +1681,12 @@ SC_FUNC char *strins(char *dest,char *src,size_t srclen)
 
 static int substpattern(unsigned char *line,size_t buffersize,char *pattern,char *substitution)
 {
+  SC_VSTATIC unsigned char expansion[sLINEMAX+1];
   int prefixlen;
   const unsigned char *p,*s,*e;
-  unsigned char *args[10];
+  const unsigned char *args[10];  /* parameters are slices of the source line */
+  int arglen[10];
+  unsigned char *d;
   int match,arg,len,instring;
   int stringize;
 
@@ -1501,13 +1726,8 @@ static int substpattern(unsigned char *line,size_t buffersize,char *pattern,char
                        * a string, or the closing paranthese of a group) */
         } /* while */
         /* store the parameter (overrule any earlier) */
-        if (args[arg]!=NULL)
-          free(args[arg]);
-        len=(int)(e-s);
-        args[arg]=(unsigned char*)malloc((len+1)*sizeof(unsigned char));
-        if (args[arg]==NULL)
-          error(103); /* insufficient memory */
-        strlcpy((char*)args[arg],(char*)s,len+1);
+        args[arg]=s;
+        arglen[arg]=(int)(e-s);
         /* character behind the pattern was matched too */
         if (*e==*p) {
           s=e+1;
@@ -1570,7 +1790,7 @@ static int substpattern(unsigned char *line,size_t buffersize,char *pattern,char
         assert(arg>=0 && arg<=9);
         assert(stringize==0 || stringize==1);
         if (args[arg]!=NULL)
-          len+=strlen((char*)args[arg])+2*stringize;
+          len+=arglen[arg]+2*stringize;
         else
           len+=2;     /* copy '%' plus digit */
         e++;          /* skip %, digit is skipped later */
@@ -1584,10 +1804,12 @@ static int substpattern(unsigned char *line,size_t buffersize,char *pattern,char
     if (strlen((char*)line) + len - (int)(s-line) > buffersize) {
       error(75);      /* line too long */
     } else {
-      /* substitute pattern */
+      /* build the substitution in a separate buffer (the parameters still
+       * point into the line), then replace the matched text in one step
+       */
+      assert(len<=sLINEMAX);
       instring=0;
-      strdel((char*)line,(int)(s-line));
-      for (e=(unsigned char*)substitution,s=line; *e!='\0'; e++) {
+      for (e=(unsigned char*)substitution,d=expansion; *e!='\0'; e++) {
         if (*e=='#' && *(e+1)=='%' && isdigit(*(e+2)) && !instring) {
           stringize=1;
           e++;            /* skip '#' */
@@ -1599,31 +1821,29 @@ static int substpattern(unsigned char *line,size_t buffersize,char *pattern,char
           assert(arg>=0 && arg<=9);
           if (args[arg]!=NULL) {
             if (stringize)
-              strins((char*)s++,"\"",1);
-            strins((char*)s,(char*)args[arg],strlen((char*)args[arg]));
-            s+=strlen((char*)args[arg]);
+              *d++='"';
+            memcpy(d,args[arg],arglen[arg]);
+            d+=arglen[arg];
             if (stringize)
-              strins((char*)s++,"\"",1);
+              *d++='"';
           } else {
             error(236); /* parameter does not exist, incorrect #define pattern */
-            strins((char*)s,(char*)e,2);
-            s+=2;
+            *d++=*e;
+            *d++=*(e+1);
           } /* if */
           e++;          /* skip %, digit is skipped later */
         } else {
           if (*e=='"')
             instring=!instring;
-          strins((char*)s,(char*)e,1);
-          s++;
+          *d++=*e;
         } /* if */
       } /* for */
+      assert((int)(d-expansion)==len);
+      memmove(line+len,s,strlen((char*)s)+1);
+      memcpy(line,expansion,len);
     } /* if */
   } /* if */
 
-  for (arg=0; arg<10; arg++)
-    if (args[arg]!=NULL)
-      free(args[arg]);
-
   return match;
 }
 
@@ -1696,7 +1916,7 @@ static void substallpatterns(unsigned char *line,int buffersize)
  */
 static int scanellipsis(const unsigned char *lptr)
 {
-  static void *inpfmark=NULL;
+  SC_VSTATIC void *inpfmark=NULL;
   unsigned char *localbuf;
   short localcomment,found;
 
@@ -1819,8 +2039,8 @@ static void packedstring(const unsigned char *str,int flags)
     litadd(0);          /* add full cell of zeros */
 }
 
-static unsigned long pc_indentmask=0;   /* tab/space interval to make up the current indent */
-static unsigned char pc_indentbits=0;   /* bits in pc_indentmask */
+SC_VSTATIC unsigned long pc_indentmask=0;   /* tab/space interval to make up the current indent */
+SC_VSTATIC unsigned char pc_indentbits=0;   /* bits in pc_indentmask */
 
 SC_FUNC void lex_fetchindent(const unsigned char *string,const unsigned char *pos)
 {
@@ -1909,11 +2129,11 @@ SC_FUNC int lex_adjusttabsize(int matchindent)
  *                     _pushed
  */
 
-static int _pushed;
-static int _lextok;
-static cell _lexval;
-static char *_lexstr=NULL;
-static int _lexnewline;
+SC_VSTATIC int _pushed;
+SC_VSTATIC int _lextok;
+SC_VSTATIC cell _lexval;
+SC_VSTATIC char *_lexstr=NULL;
+SC_VSTATIC int _lexnewline;
 
 SC_FUNC int lexinit(int releaseall)
 {
@@ -1943,6 +2163,7 @@ SC_FUNC int lexinit(int releaseall)
       return 0;
     *srcline='\0';
     *_lexstr='\0';
+    init_tokenchains();
   } /* if */
   return 1;
 }
@@ -1962,10 +2183,41 @@ char *sc_tokens[] = {
          "-label-", "-string-"
        };
 
+/* For the multi-character operators, reserved words and directives (the
+ * tokens tFIRST..tLAST), the tokens are chained on their first character, so
+ * that lex() only needs to compare the tokens that start with the same
+ * character as the input. The chains keep the order of the tokens in
+ * sc_tokens[], so that the first match is the same as in a linear search.
+ */
+SC_VSTATIC short firstoperator[256];  /* index (relative to tFIRST) of the first token in each chain */
+SC_VSTATIC short firstkeyword[256];
+SC_VSTATIC short nexttoken[tLAST-tFIRST+1];
+SC_VSTATIC unsigned char tokenlength[tLAST-tFIRST+1];
+
+static void init_tokenchains(void)
+{
+  short *chain;
+  int i,j;
+
+  for (i=0; i<256; i++)
+    firstoperator[i]=firstkeyword[i]=-1;
+  for (i=tLAST-tFIRST; i>=0; i--) {
+    const unsigned char *token=(const unsigned char *)sc_tokens[i];
+    assert(strlen(sc_tokens[i])<256);
+    tokenlength[i]=(unsigned char)strlen(sc_tokens[i]);
+    chain= (i<=tMIDDLE-tFIRST) ? &firstoperator[token[0]] : &firstkeyword[token[0]];
+    nexttoken[i]=*chain;
+    *chain=(short)i;  /* inserting in reverse order keeps the table order */
+    /* reserved words and directives are a '#' or a letter followed by letters */
+    assert(i<=tMIDDLE-tFIRST || token[0]=='#' || alpha(token[0]));
+    for (j=1; i>tMIDDLE-tFIRST && j<tokenlength[i]; j++)
+      assert(alpha(token[j]));
+  } /* for */
+}
+
 SC_FUNC int lex(cell *lexvalue,char **lexsym)
 {
-  int i,toolong,newline;
-  char **tokptr;
+  int i,toolong,newline,rational;
   const unsigned char *starttoken;
 
   assert(lexvalue!=NULL);
@@ -2004,37 +2256,38 @@ SC_FUNC int lex(cell *lexvalue,char **lexsym)
   if (newline)
     lex_fetchindent(srcline,lptr);
 
-  i=tFIRST;
-  tokptr=sc_tokens;
-  while (i<=tMIDDLE) {  /* match multi-character operators */
-    if (*lptr==**tokptr && match(*tokptr,FALSE)) {
-      _lextok=i;
+  /* match multi-character operators */
+  for (i=firstoperator[*lptr]; i>=0; i=nexttoken[i]) {
+    if (match(sc_tokens[i],FALSE)) {
+      _lextok=i+tFIRST;
       if (pc_docexpr)   /* optionally concatenate to documentation string */
-        insert_autolist(*tokptr);
+        insert_autolist(sc_tokens[i]);
       return _lextok;
     } /* if */
-    i+=1;
-    tokptr+=1;
-  } /* while */
-  while (i<=tLAST) {    /* match reserved words and compiler directives */
-    if (*lptr==**tokptr && match(*tokptr,TRUE)) {
-      _lextok=i;
-      errorset(sRESET,0); /* reset error flag (clear the "panic mode")*/
-      if (pc_docexpr)   /* optionally concatenate to documentation string */
-        insert_autolist(*tokptr);
-      return _lextok;
-    } /* if */
-    i+=1;
-    tokptr+=1;
-  } /* while */
+  } /* for */
+  /* match reserved words and compiler directives; these must be followed
+   * by a non-alphanumeric character, so only a word of the same length can
+   * match
+   */
+  if ((i=firstkeyword[*lptr])>=0) {
+    int len=1;
+    while (alphanum(lptr[len]))
+      len++;
+    for ( ; i>=0; i=nexttoken[i]) {
+      if (tokenlength[i]==len && memcmp(sc_tokens[i],lptr,len)==0) {
+        lptr+=len;
+        _lextok=i+tFIRST;
+        errorset(sRESET,0); /* reset error flag (clear the "panic mode")*/
+        if (pc_docexpr)   /* optionally concatenate to documentation string */
+          insert_autolist(sc_tokens[i]);
+        return _lextok;
+      } /* if */
+    } /* for */
+  } /* if */
 
   starttoken=lptr;      /* save start pointer (for concatenating to documentation string) */
-  if ((i=number(&_lexval,lptr))!=0) {   /* number (non-floating point) */
-    _lextok=tNUMBER;
-    *lexvalue=_lexval;
-    lptr+=i;
-  } else if ((i=ftoi(&_lexval,lptr))!=0) {
-    _lextok=tRATIONAL;
+  if ((i=number(&_lexval,lptr,&rational))!=0) {
+    _lextok= rational ? tRATIONAL : tNUMBER;
     *lexvalue=_lexval;
     lptr+=i;
   } else if (isdigit(*lptr)) {
@@ -2539,6 +2792,28 @@ static cell litchar(const unsigned char **lptr,int flags)
   return c;
 }
 
+/* Character classes for alpha(), alphanum() and ishex(); these replace calls
+ * to isalpha() and isdigit(), which gave the same result, because the
+ * compiler runs in the "C" locale. The '@' in the table is PUBLIC_CHAR.
+ */
+#define CC_ALPHA  0x01  /* letter, "_" or "@" */
+#define CC_DIGIT  0x02  /* decimal digit */
+#define CC_HEX    0x04  /* hexadecimal digit */
+#define CC_A      CC_ALPHA
+#define CC_AH     (CC_ALPHA | CC_HEX)
+#define CC_DH     (CC_DIGIT | CC_HEX)
+static const unsigned char charclass[256] = {
+  0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /* 0x00 */
+  0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /* 0x10 */
+  0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    /* 0x20 */
+  CC_DH,CC_DH,CC_DH,CC_DH,CC_DH,CC_DH,CC_DH,CC_DH,CC_DH,CC_DH,0,    0,    0,    0,    0,    0,    /* 0x30 "0".."9" */
+  CC_A, CC_AH,CC_AH,CC_AH,CC_AH,CC_AH,CC_AH,CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, /* 0x40 "@", "A".."O" */
+  CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, 0,    0,    0,    0,    CC_A, /* 0x50 "P".."Z", "_" */
+  0,    CC_AH,CC_AH,CC_AH,CC_AH,CC_AH,CC_AH,CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, /* 0x60 "a".."o" */
+  CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, CC_A, 0,    0,    0,    0,    0     /* 0x70 "p".."z" */
+  /* 0x80..0xff: all zero */
+};
+
 /*  alpha
  *
  *  Test if character "c" is alphabetic ("a".."z"), an underscore ("_")
@@ -2546,7 +2821,7 @@ static cell litchar(const unsigned char **lptr,int flags)
  */
 static int alpha(unsigned char c)
 {
-  return (isalpha(c) || c=='_' || c==PUBLIC_CHAR);
+  return (charclass[c] & CC_ALPHA)!=0;
 }
 
 /*  alphanum
@@ -2555,7 +2830,7 @@ static int alpha(unsigned char c)
  */
 SC_FUNC int alphanum(unsigned char c)
 {
-  return (alpha(c) || isdigit(c));
+  return (charclass[c] & (CC_ALPHA | CC_DIGIT))!=0;
 }
 
 /*  ishex
@@ -2564,28 +2839,126 @@ SC_FUNC int alphanum(unsigned char c)
  */
 SC_FUNC int ishex(char c)
 {
-  return (c>='0' && c<='9') || (c>='a' && c<='f') || (c>='A' && c<='F');
+  return (charclass[(unsigned char)c] & CC_HEX)!=0;
+}
+
+/* Both symbol tables are also indexed on a hash of the full name, so that a
+ * look-up only runs through the symbols in a single bucket. A new symbol is
+ * inserted at the head of its bucket. For the local table, this mirrors the
+ * list itself, where the innermost declaration comes first. For the global
+ * table, add_symbol() inserts a symbol in front of any global symbol with
+ * the same name, so the relative order of equally named symbols is the same
+ * in the bucket as in the sorted list.
+ */
+SC_VSTATIC symbol *glbhash[sGLBHASH];
+SC_VSTATIC symbol *lochash[sLOCHASH];
+
+static symbol **hashbucket(const symbol *root,uint32_t hash)
+{
+  if (root==&glbtab)
+    return &glbhash[hash & (sGLBHASH-1)];
+  if (root==&loctab)
+    return &lochash[hash & (sLOCHASH-1)];
+  return NULL;
+}
+
+static void hash_unlink(const symbol *root,symbol *sym)
+{
+  symbol **ptr;
+
+  if ((ptr=hashbucket(root,sym->hash))==NULL)
+    return;
+  while (*ptr!=NULL && *ptr!=sym)
+    ptr=&(*ptr)->hnext;
+  if (*ptr==sym)
+    *ptr=sym->hnext;
+  sym->hnext=NULL;
+}
+
+/* Symbols are allocated from blocks that hold many symbols at once; deleted
+ * symbols go to a free list and are recycled by add_symbol(). Since most of
+ * the symbols are deleted and re-created between the passes, this avoids a
+ * malloc()/free() pair for each of them, and it keeps the symbols close
+ * together in memory. The blocks are released in bulk (together with the
+ * hash indices) by delete_symbolpool(), at the end of the compilation.
+ */
+#define SYMBOLS_PER_BLOCK 256
+typedef struct s_symbolblock {
+  struct s_symbolblock *next;
+  symbol symbols[SYMBOLS_PER_BLOCK];
+} symbolblock;
+SC_VSTATIC symbolblock *symbolblocks=NULL;
+SC_VSTATIC symbol *freesymbols=NULL;
+
+static symbol *alloc_symbol(void)
+{
+  symbol *sym;
+
+  if (freesymbols==NULL) {
+    symbolblock *block;
+    int i;
+    if ((block=(symbolblock*)malloc(sizeof(symbolblock)))==NULL)
+      return NULL;
+    block->next=symbolblocks;
+    symbolblocks=block;
+    for (i=SYMBOLS_PER_BLOCK-1; i>=0; i--) {
+      block->symbols[i].next=freesymbols;
+      freesymbols=&block->symbols[i];
+    } /* for */
+  } /* if */
+  sym=freesymbols;
+  freesymbols=sym->next;
+  return sym;
+}
+
+static void release_symbol(symbol *sym)
+{
+  sym->next=freesymbols;
+  freesymbols=sym;
+}
+
+SC_FUNC void delete_symbolpool(void)
+{
+  symbolblock *block;
+
+  while (symbolblocks!=NULL) {
+    block=symbolblocks->next;
+    free(symbolblocks);
+    symbolblocks=block;
+  } /* while */
+  freesymbols=NULL;
+  delete_refertable();
+  memset(glbhash,0,sizeof glbhash);
+  memset(lochash,0,sizeof lochash);
 }
 
 /* The local variable table must be searched backwards, so that the deepest
  * nesting of local variables is searched first. The simplest way to do
- * this is to insert all new items at the head of the list.
+ * this is to insert all new items at the head of the list. As a result,
+ * the local table is also a stack of scopes: the symbols of the innermost
+ * compound block form the head of the list, so leaving a block only has to
+ * look at the symbols of that block.
  * In the global list, the symbols are kept in sorted order, so that the
  * public functions are written in sorted order.
  */
 static symbol *add_symbol(symbol *root,symbol *entry,int sort)
 {
-  symbol *newsym;
-
-  if (sort)
-    while (root->next!=NULL && strcmp(entry->name,root->next->name)>0)
-      root=root->next;
+  symbol *newsym,**bucket;
 
-  if ((newsym=(symbol *)malloc(sizeof(symbol)))==NULL) {
+  if ((newsym=alloc_symbol())==NULL) {
     error(103);
     return NULL;
   } /* if */
   memcpy(newsym,entry,sizeof(symbol));
+  newsym->hnext=NULL;
+  if ((bucket=hashbucket(root,newsym->hash))!=NULL) {
+    newsym->hnext=*bucket;
+    *bucket=newsym;
+  } /* if */
+
+  if (sort)
+    while (root->next!=NULL && strcmp(entry->name,root->next->name)>0)
+      root=root->next;
   newsym->next=root->next;
   root->next=newsym;
   return newsym;
@@ -2599,6 +2972,8 @@ static void free_symbol(symbol *sym)
    * kind of the symbol
    */
   assert(sym!=NULL);
+  if (sym==line_sym)
+    line_sym=NULL;
   if (sym->ident==iFUNCTN) {
     /* run through the argument list; "default array" arguments
      * must be freed explicitly; the tag list must also be freed */
@@ -2629,32 +3004,66 @@ static void free_symbol(symbol *sym)
     free(sym->dim.enumlist);
   } /* if */
   assert(sym->refer!=NULL);
+  unrefer_all(sym);
   free(sym->refer);
+  if (sym->referto!=NULL)
+    free(sym->referto);
   if (sym->documentation!=NULL)
     free(sym->documentation);
-  free(sym);
+  release_symbol(sym);
+}
+
+/* Removes a symbol from the child list of its parent. */
+static void unlink_child(symbol *sym)
+{
+  symbol **ptr;
+
+  if (sym->parent==NULL)
+    return;
+  for (ptr=&sym->parent->child; *ptr!=NULL && *ptr!=sym; ptr=&(*ptr)->sibling)
+    /* nothing */;
+  if (*ptr==sym)
+    *ptr=sym->sibling;
+  sym->sibling=NULL;
+}
+
+/* Deletes the sub-symbols of a symbol; a sub-symbol is always in the same
+ * table as its parent.
+ */
+static void delete_children(symbol *root,symbol *sym)
+{
+  while (sym->child!=NULL)
+    delete_symbol(root,sym->child);
 }
 
 SC_FUNC void delete_symbol(symbol *root,symbol *sym)
 {
+  symbol *prev;
+
+  /* a symbol takes its sub-symbols with it */
+  delete_children(root,sym);
+
   /* find the symbol and its predecessor
    * (this function assumes that you will never delete a symbol that is not
    * in the table pointed at by "root")
    */
   assert(root!=sym);
-  while (root->next!=sym) {
-    root=root->next;
-    assert(root!=NULL);
+  prev=root;
+  while (prev->next!=sym) {
+    prev=prev->next;
+    assert(prev!=NULL);
   } /* while */
 
   /* unlink it, then free it */
-  root->next=sym->next;
+  prev->next=sym->next;
+  hash_unlink(root,sym);
+  unlink_child(sym);
   free_symbol(sym);
 }
 
 SC_FUNC void delete_symbols(symbol *root,int level,int delete_labels,int delete_functions)
 {
-  symbol *base;
+  symbol *base,*stop;
   symbol *sym,*parent_sym,*child_sym;
   statelist *stateptr;
   int mustdelete;
@@ -2717,14 +3126,17 @@ SC_FUNC void delete_symbols(symbol *root,int level,int delete_labels,int delete_
       break;
     } /* switch */
     if (mustdelete) {
-      /* first delete children, if any */
-      int count=0;
-      while ((child_sym=finddepend(sym))!=NULL) {
-        delete_symbol(root,child_sym);
-        count++;
-      } /* while */
-      if (count==0) {
+      /* the children are deleted together with the symbol; this only
+       * invalidates "base" if that symbol is one of these children
+       */
+      for (child_sym=base; child_sym!=NULL && child_sym!=sym; child_sym=child_sym->parent)
+        /* nothing */;
+      if (child_sym==NULL) {
+        delete_children(root,sym);
+        assert(base->next==sym);
         base->next=sym->next;
+        hash_unlink(root,sym);
+        unlink_child(sym);
         free_symbol(sym);
       } else {
         /* chain has changed */
@@ -2754,31 +3166,65 @@ SC_FUNC void delete_symbols(symbol *root,int level,int delete_labels,int delete_
     } /* if */
   } /* if */
 
-  /* go through the symbols again to erase any "visited" marks */
-  for (sym=root->next; sym!=NULL; sym=sym->next)
+  /* go through the symbols again to erase any "visited" marks; all marked
+   * symbols precede the symbol at which the loop above stopped (for the
+   * local table, these are the symbols of the scope that is being closed)
+   */
+  stop=base->next;
+  for (sym=root->next; sym!=stop; sym=sym->next)
     sym->usage &= ~uVISITED;
 }
 
 /* The purpose of the hash is to reduce the frequency of a "name"
- * comparison (which is costly). There is little interest in avoiding
- * clusters in similar names, which is why this function is plain simple.
+ * comparison (which is costly) and to select the bucket in the global
+ * symbol index. Since all characters of the name contribute, names that
+ * differ only in the middle (common for generated or prefixed names) still
+ * spread over the buckets. This is the 32-bit FNV-1a hash.
  */
 SC_FUNC uint32_t namehash(const char *name)
 {
   const unsigned char *ptr=(const unsigned char *)name;
-  int len=strlen(name);
-  if (len==0)
-    return 0L;
-  assert(len<256);
-  return (len<<24Lu) + (ptr[0]<<16Lu) + (ptr[len-1]<<8Lu) + (ptr[len>>1Lu]);
+  uint32_t hash=2166136261Lu;
+  while (*ptr!='\0') {
+    hash^=*ptr++;
+    hash*=16777619Lu;
+  } /* while */
+  return hash;
+}
+
+/*  rename_symbol
+ *
+ *  Changes the name of a symbol, and moves it to the bucket for the new
+ *  name if it is in the global symbol table.
+ */
+SC_FUNC void rename_symbol(symbol *sym,const char *newname)
+{
+  symbol **ptr;
+  int indexed=FALSE;
+
+  assert(sym!=NULL);
+  assert(strlen(newname)<=sNAMEMAX);
+  for (ptr=hashbucket(&glbtab,sym->hash); *ptr!=NULL && !indexed; ptr=&(*ptr)->hnext)
+    indexed=(*ptr==sym);
+  if (indexed)
+    hash_unlink(&glbtab,sym);
+  strcpy(sym->name,newname);
+  sym->hash=namehash(sym->name);
+  if (indexed) {
+    ptr=hashbucket(&glbtab,sym->hash);
+    sym->hnext=*ptr;
+    *ptr=sym;
+  } /* if */
 }
 
 static symbol *find_symbol(const symbol *root,const char *name,int fnumber,int automaton,int *cmptag)
 {
   symbol *firstmatch=NULL;
-  symbol *sym=root->next;
+  symbol *sym;
   int count=0;
-  unsigned long hash=namehash(name);
+  uint32_t hash=namehash(name);
+  symbol **bucket=hashbucket(root,hash);
+  sym=(bucket!=NULL) ? *bucket : root->next;
   while (sym!=NULL) {
     if (hash==sym->hash && strcmp(name,sym->name)==0        /* check name */
         && (sym->parent==NULL || sym->ident==iCONSTEXPR)    /* sub-types (hierarchical types) are skipped, except for enum fields */
@@ -2803,24 +3249,140 @@ static symbol *find_symbol(const symbol *root,const char *name,int fnumber,int a
         } /* if */
       } /* if */
     } /*  */
-    sym=sym->next;
+    sym=(bucket!=NULL) ? sym->hnext : sym->next;
   } /* while */
   if (cmptag!=NULL && firstmatch!=NULL)
     *cmptag=count;
   return firstmatch;
 }
 
-static symbol *find_symbol_child(const symbol *root,const symbol *sym)
+/* The referrer lists form a graph: the "refer" list of a symbol holds the
+ * functions that use the symbol, and the "referto" list of a function holds
+ * the symbols that the function uses (the reverse edges). Each edge is also
+ * stored in a hash table, which records the position of the referrer in the
+ * "refer" list of the symbol. This makes the test for a duplicate referrer a
+ * hash look-up, and an edge can be removed without searching the lists.
+ *
+ * The "referto" list of a function is only appended to; it may still hold
+ * edges that were removed later on, or even pointers to symbols that were
+ * deleted. The hash table is the authority on whether an edge exists, so
+ * it must be checked before an entry in a "referto" list is used (see
+ * unrefer_symbol()).
+ */
+typedef struct s_referedge {
+  symbol *entry;        /* the symbol that is used */
+  symbol *bywhom;       /* the function that uses it */
+  int index;            /* position of "bywhom" in entry->refer */
+} referedge;
+
+SC_VSTATIC referedge *edgetab=NULL;
+SC_VSTATIC int edgetabsize=0;       /* number of slots in the table (power of 2) */
+SC_VSTATIC int edgetabused=0;       /* number of slots in use, including deleted ones */
+SC_VSTATIC int edgetablive=0;       /* number of edges in the table */
+SC_VSTATIC symbol edge_deleted;     /* marker for a deleted slot */
+
+static unsigned int edgehash(const symbol *entry,const symbol *bywhom)
+{
+  size_t h=((size_t)entry>>4) ^ ((size_t)bywhom>>4)*0x9e3779b1u;
+  return (unsigned int)(h ^ (h>>15));
+}
+
+static referedge *edge_find(const symbol *entry,const symbol *bywhom)
 {
-  symbol *ptr=root->next;
-  while (ptr!=NULL) {
-    if (ptr->parent==sym)
-      return ptr;
-    ptr=ptr->next;
-  } /* while */
+  unsigned int idx;
+
+  if (edgetab==NULL)
+    return NULL;
+  for (idx=edgehash(entry,bywhom) & (edgetabsize-1); edgetab[idx].entry!=NULL; idx=(idx+1) & (edgetabsize-1))
+    if (edgetab[idx].entry==entry && edgetab[idx].bywhom==bywhom)
+      return &edgetab[idx];
   return NULL;
 }
 
+static int edge_insert(symbol *entry,symbol *bywhom,int index)
+{
+  unsigned int idx;
+
+  if (2*(edgetabused+1)>edgetabsize) {
+    /* grow the table (or rebuild it without the deleted slots) */
+    referedge *oldtab=edgetab;
+    int oldsize=edgetabsize;
+    referedge *newtab;
+    int i;
+    int newsize=edgetabsize;
+    if (newsize==0)
+      newsize=1024;
+    else if (4*(edgetablive+1)>edgetabsize)
+      newsize*=2;               /* else, only purge the deleted slots */
+    newtab=(referedge*)calloc(newsize,sizeof(referedge));
+    if (newtab==NULL)
+      return FALSE;             /* insufficient memory */
+    edgetab=newtab;
+    edgetabsize=newsize;
+    edgetabused=0;
+    for (i=0; i<oldsize; i++) {
+      if (oldtab[i].entry!=NULL && oldtab[i].entry!=&edge_deleted) {
+        for (idx=edgehash(oldtab[i].entry,oldtab[i].bywhom) & (edgetabsize-1); edgetab[idx].entry!=NULL; idx=(idx+1) & (edgetabsize-1))
+          /* nothing */;
+        edgetab[idx]=oldtab[i];
+        edgetabused++;
+      } /* if */
+    } /* for */
+    free(oldtab);
+  } /* if */
+
+  for (idx=edgehash(entry,bywhom) & (edgetabsize-1); edgetab[idx].entry!=NULL; idx=(idx+1) & (edgetabsize-1))
+    /* nothing */;
+  edgetab[idx].entry=entry;
+  edgetab[idx].bywhom=bywhom;
+  edgetab[idx].index=index;
+  edgetabused++;
+  edgetablive++;
+  return TRUE;
+}
+
+/* removes the edge from the hash table and from the referrer list of the
+ * symbol that is used
+ */
+static void edge_remove(referedge *edge)
+{
+  symbol *entry=edge->entry;
+
+  assert(entry!=NULL && entry!=&edge_deleted);
+  assert(edge->index<entry->numrefers && entry->refer[edge->index]==edge->bywhom);
+  entry->refer[edge->index]=NULL;
+  entry->refcount--;
+  assert(entry->refcount>=0);
+  edge->entry=&edge_deleted;
+  edge->bywhom=NULL;
+  edgetablive--;
+}
+
+/* Removes all edges of a symbol that is about to be deleted, both those where
+ * it is used and those where it is the referrer.
+ */
+static void unrefer_all(symbol *sym)
+{
+  referedge *edge;
+  int i;
+
+  for (i=0; i<sym->numrefers; i++)
+    if (sym->refer[i]!=NULL && (edge=edge_find(sym,sym->refer[i]))!=NULL)
+      edge_remove(edge);
+  for (i=0; i<sym->numreferto; i++)
+    if ((edge=edge_find(sym->referto[i],sym))!=NULL)
+      edge_remove(edge);
+}
+
+SC_FUNC void delete_refertable(void)
+{
+  free(edgetab);
+  edgetab=NULL;
+  edgetabsize=0;
+  edgetabused=0;
+  edgetablive=0;
+}
+
 /* Adds "bywhom" to the list of referrers of "entry". Typically,
  * bywhom will be the function that uses a variable or that calls
  * the function.
@@ -2834,12 +3396,8 @@ SC_FUNC int refer_symbol(symbol *entry,symbol *bywhom)
   assert(entry->refer!=NULL);
 
   /* see if it is already there */
-  for (count=0; count<entry->numrefers && entry->refer[count]!=bywhom; count++)
-    /* nothing */;
-  if (count<entry->numrefers) {
-    assert(entry->refer[count]==bywhom);
+  if (edge_find(entry,bywhom)!=NULL)
     return TRUE;
-  } /* if */
 
   /* see if there is an empty spot in the referrer list */
   for (count=0; count<entry->numrefers && entry->refer[count]!=NULL; count++)
@@ -2861,9 +3419,46 @@ SC_FUNC int refer_symbol(symbol *entry,symbol *bywhom)
     entry->numrefers=newsize;
   } /* if */
 
+  /* add the reverse edge */
+  if (bywhom->numreferto==bywhom->maxreferto) {
+    symbol **referto;
+    int newsize=(bywhom->maxreferto==0) ? 4 : 2*bywhom->maxreferto;
+    referto=(symbol**)realloc(bywhom->referto,newsize*sizeof(symbol*));
+    if (referto==NULL)
+      return FALSE;             /* insufficient memory */
+    bywhom->referto=referto;
+    bywhom->maxreferto=newsize;
+  } /* if */
+  if (!edge_insert(entry,bywhom,count))
+    return FALSE;               /* insufficient memory */
+  bywhom->referto[bywhom->numreferto++]=entry;
+
   /* add the referrer */
   assert(entry->refer[count]==NULL);
   entry->refer[count]=bywhom;
+  entry->refcount++;
+  return TRUE;
+}
+
+/* Returns whether "bywhom" is in the list of referrers of "entry". The
+ * "entry" pointer is not dereferenced, so this function may be called with
+ * any pointer from a "referto" list.
+ */
+SC_FUNC int is_referrer(const symbol *entry,const symbol *bywhom)
+{
+  return edge_find(entry,bywhom)!=NULL;
+}
+
+/* Removes "bywhom" from the list of referrers of "entry"; returns FALSE if
+ * "bywhom" was not a referrer of "entry".
+ */
+SC_FUNC int unrefer_symbol(symbol *entry,symbol *bywhom)
+{
+  referedge *edge;
+
+  if ((edge=edge_find(entry,bywhom))==NULL)
+    return FALSE;
+  edge_remove(edge);
   return TRUE;
 }
 
@@ -2899,7 +3494,7 @@ SC_FUNC symbol *findglb(const char *name,int filter)
 
   if (filter>sGLOBAL && sc_curstates>0) {
     /* find a symbol whose state list matches the current fsa */
-    sym=find_symbol(&glbtab,name,fcurrent,state_getfsa(sc_curstates),NULL);
+    sym=find_symbol(&glbtab,name,fscope,state_getfsa(sc_curstates),NULL);
     if (sym!=NULL && sym->ident!=iFUNCTN) {
       /* if sym!=NULL, we found a variable in the automaton; now we should
        * also verify whether there is an intersection between the symbol's
@@ -2915,7 +3510,7 @@ SC_FUNC symbol *findglb(const char *name,int filter)
    * that has no state(s) attached to it
    */
   if (sym==NULL)
-    sym=find_symbol(&glbtab,name,fcurrent,-1,NULL);
+    sym=find_symbol(&glbtab,name,fscope,-1,NULL);
   return sym;
 }
 
@@ -2935,7 +3530,7 @@ SC_FUNC symbol *findconst(const char *name,int *cmptag)
 
   sym=find_symbol(&loctab,name,-1,-1,cmptag);  /* try local symbols first */
   if (sym==NULL || sym->ident!=iCONSTEXPR)     /* not found, or not a constant */
-    sym=find_symbol(&glbtab,name,fcurrent,-1,cmptag);
+    sym=find_symbol(&glbtab,name,fscope,-1,cmptag);
   if (sym==NULL || sym->ident!=iCONSTEXPR)
     return NULL;
   assert(sym->parent==NULL || (sym->usage & uENUMFIELD)!=0);
@@ -2943,14 +3538,35 @@ SC_FUNC symbol *findconst(const char *name,int *cmptag)
   return sym;
 }
 
+/*  finddepend
+ *
+ *  Returns the (first) sub-symbol of a hierarchical symbol, such as the next
+ *  dimension of an array, or NULL if the symbol has no sub-symbols.
+ */
 SC_FUNC symbol *finddepend(const symbol *parent)
 {
-  symbol *sym;
+  assert(parent!=NULL);
+  return parent->child;
+}
 
-  sym=find_symbol_child(&loctab,parent);    /* try local symbols first */
-  if (sym==NULL)                            /* not found */
-    sym=find_symbol_child(&glbtab,parent);
-  return sym;
+/*  setparent
+ *
+ *  Makes "sym" a sub-symbol of "parent" (or detaches it from its current
+ *  parent if "parent" is NULL). The parent keeps a list of its sub-symbols,
+ *  so that finddepend() does not need to search the symbol tables.
+ */
+SC_FUNC void setparent(symbol *sym,symbol *parent)
+{
+  assert(sym!=NULL);
+  assert(sym!=parent);
+  if (sym->parent==parent)
+    return;
+  unlink_child(sym);
+  sym->parent=parent;
+  if (parent!=NULL) {
+    sym->sibling=parent->child;
+    parent->child=sym;
+  } /* if */
 }
 
 /*  addsym
@@ -3020,7 +3636,7 @@ SC_FUNC symbol *addvariable(const char *name,cell addr,int ident,int vclass,int
       top->dim.array.length=dim[level];
       top->dim.array.level=(short)(numdim-level-1);
       top->x.tags.index=idxtag[level];
-      top->parent=parent;
+      setparent(top,parent);
       parent=top;
       if (level==0)
         sym=top;
@@ -3048,7 +3664,7 @@ SC_FUNC int getlabel(void)
  */
 SC_FUNC char *itoh(ucell val)
 {
-static char itohstr[30];
+SC_VSTATIC char itohstr[30];
   char *ptr;
   int i,nibble[16];             /* a 64-bit hexadecimal cell has 16 nibbles */
   int max;
@@ -61,9 +61,9 @@ static int dbltest(void (*oper)(),value *lval1,value *lval2);
 static int commutative(void (*oper)());
 static int constant(value *lval);
 
-static char lastsymbol[sNAMEMAX+1]; /* name of last function/variable */
-static int bitwise_opercount;   /* count of bitwise operators in an expression */
-static int decl_heap=0;
+SC_VSTATIC char lastsymbol[sNAMEMAX+1]; /* name of last function/variable */
+SC_VSTATIC int bitwise_opercount;   /* count of bitwise operators in an expression */
+SC_VSTATIC int decl_heap=0;
 
 /* Function addresses of binary operators for signed operations */
 static void (* const op1[17])(void) = {
@@ -2106,8 +2106,8 @@ enum {
  */
 static void callfunction(symbol *sym,value *lval_result,int matchparanthesis)
 {
-static long nest_stkusage=0L;
-static int nesting=0;
+SC_VSTATIC long nest_stkusage=0L;
+SC_VSTATIC int nesting=0;
   int locheap;
   int close,lvalue;
   int argpos;       /* index in the output stream (argpos==nargs if positional parameters) */
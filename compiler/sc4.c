@@ -30,7 +30,7 @@
 #endif
 #include "sc.h"
 
-static int fcurseg;     /* the file number (fcurrent) for the active segment */
+SC_VSTATIC int fcurseg;     /* the file number (fcurrent) for the active segment */
 
 
 /* When a subroutine returns to address 0, the AMX must halt. In earlier
@@ -54,12 +54,12 @@
 #endif
 
 #define NUM_WARNINGS    (sizeof warnmsg / sizeof warnmsg[0])
-static unsigned char warndisable[(NUM_WARNINGS + 7) / 8]; /* 8 flags in a char */
+SC_VSTATIC unsigned char warndisable[(NUM_WARNINGS + 7) / 8]; /* 8 flags in a char */
 
-static int errflag;
-static int errfile;
-static int errstart;    /* line number at which the instruction started */
-static int errline;     /* forced line number for the error message */
+SC_VSTATIC int errflag;
+SC_VSTATIC int errfile;
+SC_VSTATIC int errstart;    /* line number at which the instruction started */
+SC_VSTATIC int errline;     /* forced line number for the error message */
 
 /*  error
  *
@@ -76,8 +76,8 @@ static int errline;     /* forced line number for the error message */
 SC_FUNC int error(long number,...)
 {
 static char *prefix[3]={ "error", "fatal error", "warning" };
-static int lastline,errorcount;
-static short lastfile;
+SC_VSTATIC int lastline,errorcount;
+SC_VSTATIC short lastfile;
   char *msg,*pre,*filename;
   va_list argptr;
   char string[256];
@@ -46,10 +46,10 @@ typedef struct {
   OPCODE_PROC func;
 } OPCODE;
 
-static cell *lbltab;    /* label table */
-static int writeerror;
-static int bytes_in, bytes_out;
-static jmp_buf compact_err;
+SC_VSTATIC cell *lbltab;    /* label table */
+SC_VSTATIC int writeerror;
+SC_VSTATIC int bytes_in, bytes_out;
+SC_VSTATIC jmp_buf compact_err;
 
 /* apparently, strtol() does not work correctly on very large hexadecimal values */
 SC_FUNC ucell hex2ucell(const char *s,const char **n)
@@ -83,12 +83,12 @@ static void stgopt(char *start,char *end,int (*outputfunc)(char *str));
 #define sSTG_GROW   512
 #define sSTG_MAX    20480
 
-static char *stgbuf=NULL;
-static int stgmax=0;    /* current size of the staging buffer */
+SC_VSTATIC char *stgbuf=NULL;
+SC_VSTATIC int stgmax=0;    /* current size of the staging buffer */
 
-static char *stgpipe=NULL;
-static int pipemax=0;   /* current size of the stage pipe, a second staging buffer */
-static int pipeidx=0;
+SC_VSTATIC char *stgpipe=NULL;
+SC_VSTATIC int pipemax=0;   /* current size of the stage pipe, a second staging buffer */
+SC_VSTATIC int pipeidx=0;
 
 #define CHECK_STGBUFFER(index) if ((int)(index)>=stgmax)  grow_stgbuffer(&stgbuf, stgmax, (index)+1)
 #define CHECK_STGPIPE(index)   if ((int)(index)>=pipemax) grow_stgbuffer(&stgpipe, pipemax, (index)+1)
@@ -404,13 +404,16 @@ SC_FUNC void stgset(int onoff)
  * are embedded in the .EXE file in compressed format, here we expand
  * them (and allocate memory for the sequences).
  */
-static SEQUENCE *sequences;
+SC_VSTATIC SEQUENCE *sequences;
 
 SC_FUNC int phopt_init(void)
 {
   int number, i, len;
   char str[160];
 
+  if (sequences!=NULL)
+    return TRUE;        /* kept from an earlier compile (batch mode) */
+
   /* count number of sequences */
   for (number=0; sequences_cmp[number].find!=NULL; number++)
     /* nothing */;
@@ -0,0 +1,374 @@
+/*  Pawn compiler - cache of compiled output files
+ *
+ *  When a cache directory is set (option -K), the output file of a successful
+ *  compile is copied into that directory, under a key that is a hash of:
+ *  - the compiler build and the cell size;
+ *  - the options that were set on the command line or in the configuration
+ *    file (see cachekey() in SC1.C);
+ *  - the names and the contents of the main source files.
+ *  The copy of the output file is preceded by a list of all files that the
+ *  compile read through #include (with a hash on their contents). On a later
+ *  compile with the same key, the output file is copied back if none of these
+ *  files changed, and the compiler does not run a single pass. The list and
+ *  the output file are in a single file, which is renamed into place in one
+ *  step, so that concurrent compiles never see the list of one compile with
+ *  the output file of another.
+ *
+ *  Only the last compile for a key is kept. Warnings are not stored, so they
+ *  are not repeated on a cache hit. A file that appears in a directory where
+ *  a #tryinclude failed to find it, is not detected.
+ *
+ *  This software is provided "as-is", without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1.  The origin of this software must not be misrepresented; you must not
+ *      claim that you wrote the original software. If you use this software in
+ *      a product, an acknowledgment in the product documentation would be
+ *      appreciated but is not required.
+ *  2.  Altered source versions must be plainly marked as such, and must not be
+ *      misrepresented as being the original software.
+ *  3.  This notice may not be removed or altered from any source distribution.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined __WIN32__ || defined _WIN32 || defined __MSDOS__
+  #include <direct.h>           /* for mkdir() */
+  #include <io.h>
+  #include <process.h>          /* for getpid() */
+#elif !defined(MACOS) || defined(__MACH__)
+  #include <unistd.h>
+#endif
+#include "lstring.h"
+#include "sc.h"
+#include "svnrev.h"
+
+#if defined FORTIFY
+  #include <alloc/fortify.h>
+#endif
+
+#define CACHE_MAGIC   "PAWNCACHE2"
+#define CACHE_BUILDID SVN_REVSTR " " __DATE__ " " __TIME__
+
+#if !defined O_BINARY
+  #define O_BINARY    0
+#endif
+
+#define FNV64_BASIS   0xcbf29ce484222325uLL
+#define FNV64_PRIME   0x100000001b3uLL
+
+SC_VSTATIC char cachedir[_MAX_PATH];
+SC_VSTATIC uint64_t cachekeyhash;
+
+static uint64_t hash_bytes(uint64_t hash,const void *data,size_t size)
+{
+  const unsigned char *ptr=(const unsigned char*)data;
+  while (size-->0) {
+    hash^=*ptr++;
+    hash*=FNV64_PRIME;
+  } /* while */
+  return hash;
+}
+
+/* hash_file() returns FALSE if the file cannot be read (this includes
+ * directories)
+ */
+static int hash_file(const char *filename,uint64_t *hash)
+{
+  unsigned char buffer[4096];
+  size_t count;
+  FILE *fp;
+  int ok;
+
+  if ((fp=fopen(filename,"rb"))==NULL)
+    return FALSE;
+  *hash=FNV64_BASIS;
+  while ((count=fread(buffer,1,sizeof buffer,fp))>0)
+    *hash=hash_bytes(*hash,buffer,count);
+  ok=!ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+/* copy_stream() copies the rest of the input file to the output file; it
+ * returns the number of bytes copied, or -1 on an error
+ */
+static long copy_stream(FILE *fsrc,FILE *fdest)
+{
+  unsigned char buffer[4096];
+  size_t count;
+  long total;
+
+  total=0;
+  while ((count=fread(buffer,1,sizeof buffer,fsrc))>0) {
+    if (fwrite(buffer,1,count,fdest)!=count)
+      return -1;
+    total+=(long)count;
+  } /* while */
+  return ferror(fsrc) ? -1 : total;
+}
+
+/* cache_name() makes the full path of a file in the cache directory */
+static void cache_name(char *path,size_t size,const char *name)
+{
+  size_t len;
+
+  strlcpy(path,cachedir,size);
+  len=strlen(path);
+  if (len>0 && path[len-1]!=DIRSEP_CHAR && len+1<size) {
+    path[len]=DIRSEP_CHAR;
+    path[len+1]='\0';
+  } /* if */
+  strlcat(path,name,size);
+}
+
+/* cache_path() makes the name of a file in the cache directory, from the
+ * key and the extension
+ */
+static void cache_path(char *path,size_t size,const char *extension)
+{
+  char name[40];
+
+  sprintf(name,"%08lx%08lx%s",(unsigned long)(cachekeyhash>>32),
+          (unsigned long)(cachekeyhash & 0xffffffffuL),extension);
+  cache_name(path,size,name);
+}
+
+/*  tempfile_commit
+ *
+ *  Renames a file made with tempfile_open() to its final name, replacing
+ *  the file by that name; a concurrent compile may have stored the same file
+ *  already. The temporary file is removed if the rename fails.
+ */
+SC_FUNC int tempfile_commit(const char *tmpname,const char *path)
+{
+  int ok;
+
+  remove(path);                 /* rename() fails on an existing file in DOS/Windows */
+  ok=rename(tmpname,path)==0;
+  if (!ok)
+    remove(tmpname);
+  return ok;
+}
+
+/*  tempfile_open
+ *
+ *  Creates a new file, for writing, and returns its name in "path". The name
+ *  starts with "base" (which may include a directory), followed by the
+ *  process id, the address of a (per thread) counter and the counter itself;
+ *  the file is created with O_EXCL, so concurrent compiles (and the jobs in
+ *  batch mode) never write to the same file.
+ */
+SC_FUNC FILE *tempfile_open(char *path,size_t size,const char *base)
+{
+  #if defined(MACOS) && !defined(__MACH__)
+    (void)path;
+    (void)size;
+    (void)base;
+    return NULL;
+  #else
+    SC_VSTATIC unsigned long counter=0;
+    char name[64];
+    FILE *fp;
+    int fd,tries;
+
+    for (tries=0; tries<100; tries++) {
+      sprintf(name,"%lx-%lx-%lx.tmp",(unsigned long)getpid(),
+              (unsigned long)(size_t)&counter,++counter);
+      strlcpy(path,base,size);
+      strlcat(path,name,size);
+      fd=open(path,O_WRONLY | O_CREAT | O_EXCL | O_BINARY,0644);
+      if (fd>=0) {
+        if ((fp=fdopen(fd,"wb"))==NULL) {
+          close(fd);
+          remove(path);
+        } /* if */
+        return fp;
+      } /* if */
+      if (errno!=EEXIST)
+        break;
+    } /* for */
+    return NULL;
+  #endif
+}
+
+/*  cache_start
+ *
+ *  Sets the cache directory and starts a new key. The key is then completed
+ *  with cache_keydata(), cache_keystring() and cache_keyfile(). The directory
+ *  is created if it does not exist; the function returns FALSE if that fails.
+ */
+SC_FUNC int cache_start(const char *directory)
+{
+  int cellsize=sizeof(cell);
+  struct stat info;
+
+  strlcpy(cachedir,directory,sizeof cachedir);
+  if (stat(cachedir,&info)!=0 || (info.st_mode & S_IFDIR)==0) {
+    #if defined __WIN32__ || defined _WIN32 || defined __MSDOS__
+      mkdir(cachedir);
+    #else
+      mkdir(cachedir,0777);
+    #endif
+    if (stat(cachedir,&info)!=0 || (info.st_mode & S_IFDIR)==0) {
+      pc_printf("cannot create the cache directory \"%s\"\n",cachedir);
+      return FALSE;
+    } /* if */
+  } /* if */
+  cachekeyhash=FNV64_BASIS;
+  cache_keystring(CACHE_BUILDID);
+  cache_keydata(&cellsize,sizeof cellsize);
+  return TRUE;
+}
+
+SC_FUNC void cache_keydata(const void *data,size_t size)
+{
+  cachekeyhash=hash_bytes(cachekeyhash,data,size);
+}
+
+SC_FUNC void cache_keystring(const char *string)
+{
+  if (string==NULL)
+    string="";
+  cachekeyhash=hash_bytes(cachekeyhash,string,strlen(string)+1);
+}
+
+/* cache_keyfile() adds the name and the contents of the file; it returns
+ * FALSE if the file cannot be read
+ */
+SC_FUNC int cache_keyfile(const char *filename)
+{
+  uint64_t hash;
+
+  if (!hash_file(filename,&hash))
+    return FALSE;
+  cache_keystring(filename);
+  cache_keydata(&hash,sizeof hash);
+  return TRUE;
+}
+
+/* read_deps() reads the list of dependencies at the start of a cache entry;
+ * it either checks whether the included files are unchanged, or it adds these
+ * files to the dependency list. The list ends with a line that holds the size
+ * of the output file that follows it; this size is stored in "size".
+ */
+static int read_deps(FILE *fp,int verify,long *size)
+{
+  char line[_MAX_PATH+40];
+  char *ptr;
+  int ok;
+
+  ok=fgets(line,sizeof line,fp)!=NULL && strncmp(line,CACHE_MAGIC,strlen(CACHE_MAGIC))==0;
+  while (ok && fgets(line,sizeof line,fp)!=NULL) {
+    if ((ptr=strchr(line,'\n'))!=NULL)
+      *ptr='\0';
+    if (line[0]=='.' && line[1]==' ') {
+      *size=atol(line+2);
+      return *size>0;
+    } else if (line[0]=='F' && line[1]==' ' && strlen(line)>19 && line[18]==' ') {
+      if (verify) {
+        uint64_t current;
+        unsigned long high,low;
+        ok=sscanf(line+2,"%8lx%8lx",&high,&low)==2
+           && hash_file(line+19,&current) && current==(((uint64_t)high<<32) | low);
+      } else {
+        insert_dependency(line+19);
+      } /* if */
+    } else if (line[0]=='W' && line[1]==' ') {
+      if (!verify)
+        insert_dependency(line+2);
+    } else {
+      ok=FALSE;
+    } /* if */
+  } /* while */
+  return FALSE;                 /* no end of the list: the entry is invalid */
+}
+
+/*  cache_fetch
+ *
+ *  Looks up the key and checks that none of the included files changed. On
+ *  a hit, the output file is copied from the cache and the included files are
+ *  added to the dependency list (for option -M).
+ */
+SC_FUNC int cache_fetch(const char *target)
+{
+  char path[_MAX_PATH];
+  FILE *fp,*fdest;
+  long size;
+  int ok;
+
+  cache_path(path,sizeof path,".out");
+  if ((fp=fopen(path,"rb"))==NULL)
+    return FALSE;
+  ok=read_deps(fp,TRUE,&size);
+  if (ok && (fdest=fopen(target,"wb"))!=NULL) {
+    ok=copy_stream(fp,fdest)==size;
+    if (fclose(fdest)!=0)
+      ok=FALSE;
+    if (!ok)
+      remove(target);
+  } else {
+    ok=FALSE;
+  } /* if */
+  if (ok) {
+    rewind(fp);
+    read_deps(fp,FALSE,&size);
+  } /* if */
+  fclose(fp);
+  return ok;
+}
+
+/*  cache_store
+ *
+ *  Copies the output file into the cache, after the list of dependencies.
+ *  The entry is written to a temporary file, and then renamed in one step.
+ */
+SC_FUNC int cache_store(const char *target)
+{
+  char path[_MAX_PATH],tmpname[_MAX_PATH];
+  char *name;
+  FILE *fp,*fsrc;
+  long size;
+  int i,ok;
+
+  if ((fsrc=fopen(target,"rb"))==NULL)
+    return FALSE;
+  fseek(fsrc,0,SEEK_END);
+  size=ftell(fsrc);
+  rewind(fsrc);
+  cache_name(path,sizeof path,"pawn");
+  if (size<=0 || (fp=tempfile_open(tmpname,sizeof tmpname,path))==NULL) {
+    fclose(fsrc);
+    return FALSE;
+  } /* if */
+  fprintf(fp,"%s\n",CACHE_MAGIC);
+  for (i=0; (name=get_dependency(i))!=NULL; i++) {
+    uint64_t hash;
+    if (hash_file(name,&hash))
+      fprintf(fp,"F %08lx%08lx %s\n",(unsigned long)(hash>>32),
+              (unsigned long)(hash & 0xffffffffuL),name);
+    else
+      fprintf(fp,"W %s\n",name);  /* a directory to watch */
+  } /* for */
+  fprintf(fp,". %ld\n",size);
+  ok=copy_stream(fsrc,fp)==size && !ferror(fp);
+  fclose(fsrc);
+  if (fclose(fp)!=0)
+    ok=FALSE;
+  cache_path(path,sizeof path,".out");
+  if (ok)
+    ok=tempfile_commit(tmpname,path);
+  else
+    remove(tmpname);
+  return ok;
+}
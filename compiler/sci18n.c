@@ -72,11 +72,12 @@ struct wordpair {
   unsigned short index;
   wchar_t code;
 };
-static char cprootpath[_MAX_PATH] = { DIRSEP_CHAR, '\0' };
-static wchar_t bytetable[256];
-static struct wordpair *wordtable = NULL;
-static unsigned wordtablesize = 0;
-static unsigned wordtabletop = 0;
+SC_VSTATIC char cprootpath[_MAX_PATH] = { DIRSEP_CHAR, '\0' };
+SC_VSTATIC char cpname[_MAX_PATH] = "";   /* name of the codepage that is loaded */
+SC_VSTATIC wchar_t bytetable[256];
+SC_VSTATIC struct wordpair *wordtable = NULL;
+SC_VSTATIC unsigned wordtablesize = 0;
+SC_VSTATIC unsigned wordtabletop = 0;
 
 
 /* read in a line delimited by '\r' or '\n'; do NOT store the '\r' or '\n' into
@@ -124,6 +125,7 @@ SC_FUNC int cp_path(const char *root, const char *directory)
   add_slash2= (len2>0 && root[len2-1]!=DIRSEP_CHAR);
   if (len1+add_slash1+len2+add_slash2>=(_MAX_PATH-MAXCODEPAGE))
     return FALSE;       /* full filename may not fit */
+  cpname[0]='\0';       /* the same name may now refer to another file */
   if (root!=NULL)
     strcpy(cprootpath,root);
   if (add_slash1) {
@@ -170,9 +172,14 @@ SC_FUNC int cp_set(const char *name)
     } /* if */
     for (index=0; index<ELEMENTS(bytetable); index++)
       bytetable[index]=(wchar_t)index;
+    cpname[0]='\0';
     return TRUE;
   } /* if */
 
+  /* a codepage stays loaded between compiles (in batch mode) */
+  if (cpname[0]!='\0' && strcmp(cpname,name)==0)
+    return TRUE;
+
   /* try to open the file as-is */
   if (strchr(name,DIRSEP_CHAR)!=NULL)
     fp=fopen(name,"rt");
@@ -274,6 +281,8 @@ SC_FUNC int cp_set(const char *name)
   } /* while */
 
   fclose(fp);
+  if (strlen(name)<sizeof cpname)
+    strcpy(cpname,name);
   return TRUE;
 }
 
@@ -391,32 +400,77 @@ SC_FUNC cell get_utf8_char(const unsigned char *string,const unsigned char **end
 }
 #endif
 
+#if !defined PAWN_NO_UTF8
+/* The result of scanning a file for its encoding is kept for the lifetime of
+ * the process, so that an include file is scanned only once, rather than on
+ * every pass (and for every script that includes it).
+ */
+typedef struct s_utf8cache {
+  struct s_utf8cache *next;
+  char *name;           /* file name, as passed to scan_utf8() */
+  short utf8;           /* file is valid UTF-8 */
+  short bom;            /* file starts with a byte order mark */
+} utf8cache;
+
+SC_VSTATIC utf8cache *utf8cache_root=NULL;
+#endif
+
+SC_FUNC void delete_utf8cache(void)
+{
+  #if !defined PAWN_NO_UTF8
+    while (utf8cache_root!=NULL) {
+      utf8cache *next=utf8cache_root->next;
+      free(utf8cache_root->name);
+      free(utf8cache_root);
+      utf8cache_root=next;
+    } /* while */
+  #endif
+}
+
 SC_FUNC int scan_utf8(FILE *fp,const char *filename)
 {
   #if defined PAWN_NO_UTF8
     return 0;
   #else
-    static void *resetpos=NULL;
+    SC_VSTATIC void *resetpos=NULL;
     int utf8=TRUE;
     int firstchar=TRUE,bom_found=FALSE;
     const unsigned char *ptr;
+    utf8cache *entry;
 
-    resetpos=pc_getpossrc(fp,resetpos);
-    while (utf8 && pc_readsrc(fp,srcline,sLINEMAX)!=NULL) {
-      ptr=srcline;
-      if (firstchar) {
-        /* check whether the very first character on the very first line
-         * starts with a byte order mark (BOM)
-         */
-        cell c=get_utf8_char(ptr,&ptr);
-        bom_found= (c==0xfeff);
-        utf8= (c>=0);
-        firstchar=FALSE;
+    for (entry=utf8cache_root; entry!=NULL && strcmp(entry->name,filename)!=0; entry=entry->next)
+      /* nothing */;
+    if (entry!=NULL) {
+      utf8=entry->utf8;
+      bom_found=entry->bom;
+    } else {
+      resetpos=pc_getpossrc(fp,resetpos);
+      while (utf8 && pc_readsrc(fp,srcline,sLINEMAX)!=NULL) {
+        ptr=srcline;
+        if (firstchar) {
+          /* check whether the very first character on the very first line
+           * starts with a byte order mark (BOM)
+           */
+          cell c=get_utf8_char(ptr,&ptr);
+          bom_found= (c==0xfeff);
+          utf8= (c>=0);
+          firstchar=FALSE;
+        } /* if */
+        while (utf8 && *ptr!='\0')
+          utf8= (get_utf8_char(ptr,&ptr)>=0);
+      } /* while */
+      pc_resetsrc(fp,resetpos);
+      if ((entry=(utf8cache*)malloc(sizeof(utf8cache)))!=NULL) {
+        if ((entry->name=duplicatestring(filename))!=NULL) {
+          entry->utf8=(short)utf8;
+          entry->bom=(short)bom_found;
+          entry->next=utf8cache_root;
+          utf8cache_root=entry;
+        } else {
+          free(entry);
+        } /* if */
       } /* if */
-      while (utf8 && *ptr!='\0')
-        utf8= (get_utf8_char(ptr,&ptr)>=0);
-    } /* while */
-    pc_resetsrc(fp,resetpos);
+    } /* if */
     if (bom_found) {
       unsigned char bom[3];
       pc_readsrc(fp,bom,3);     /* read the BOM again to strip it from the file */
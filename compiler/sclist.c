@@ -207,7 +207,7 @@ SC_FUNC void delete_stringtable(stringlist *root)
 
 
 /* ----- alias table --------------------------------------------- */
-static stringpair alias_tab = {NULL, NULL, NULL};   /* alias table */
+SC_VSTATIC stringpair alias_tab = {NULL, NULL, NULL};   /* alias table */
 
 SC_FUNC stringpair *insert_alias(char *name,char *alias)
 {
@@ -238,20 +238,45 @@ SC_FUNC void delete_aliastable(void)
 }
 
 /* ----- include paths list -------------------------------------- */
-static stringlist includepaths = {NULL, NULL};  /* directory list for include files */
+SC_VSTATIC stringlist includepaths = {NULL, NULL};  /* directory list for include files */
+SC_VSTATIC char **pathindex=NULL;   /* array of the paths, for direct access */
+SC_VSTATIC int pathcount=0;         /* number of entries in "pathindex" */
+
+static void delete_pathindex(void)
+{
+  if (pathindex!=NULL) {
+    free(pathindex);
+    pathindex=NULL;
+  } /* if */
+  pathcount=0;
+}
 
 SC_FUNC stringlist *insert_path(char *path)
 {
+  delete_pathindex();           /* rebuilt on the next call to get_path() */
   return insert_string(&includepaths,path,1);
 }
 
 SC_FUNC char *get_path(int index)
 {
-  return get_string(&includepaths,index);
+  if (pathindex==NULL && includepaths.next!=NULL) {
+    stringlist *cur;
+    int count=0;
+    for (cur=includepaths.next; cur!=NULL; cur=cur->next)
+      count++;
+    if ((pathindex=(char**)malloc(count*sizeof(char*)))==NULL)
+      return get_string(&includepaths,index);
+    for (cur=includepaths.next; cur!=NULL; cur=cur->next)
+      pathindex[pathcount++]=cur->line;
+  } /* if */
+  if (index<0 || index>=pathcount)
+    return NULL;
+  return pathindex[index];
 }
 
 SC_FUNC void delete_pathtable(void)
 {
+  delete_pathindex();
   delete_stringtable(&includepaths);
   assert(includepaths.next==NULL);
 }
@@ -260,18 +285,22 @@ SC_FUNC void delete_pathtable(void)
 /* ----- text substitution patterns ------------------------------ */
 #if !defined NO_DEFINE
 
-static stringpair substpair = { NULL, NULL, NULL};  /* list of substitution pairs */
+/* The substitution pairs are kept in a hash table, on the full prefix of the
+ * pattern (the leading identifier). Every bucket is a sorted list, like the
+ * other string pair tables, so the standard functions apply to it.
+ */
+SC_VSTATIC stringpair substhash[sSUBSTHASH];  /* lists of substitution pairs */
 
-static stringpair *substindex['z'-PUBLIC_CHAR+1]; /* quick index to first character */
-static void adjustindex(char c)
+static stringpair *substbucket(const char *name,int length)
 {
-  stringpair *cur;
-  assert(c>='A' && c<='Z' || c>='a' && c<='z' || c=='_' || c==PUBLIC_CHAR);
-  assert(PUBLIC_CHAR<'A' && 'A'<'_' && '_'<'z');
-
-  for (cur=substpair.next; cur!=NULL && cur->first[0]!=c; cur=cur->next)
-    /* nothing */;
-  substindex[(int)c-PUBLIC_CHAR]=cur;
+  uint32_t hash=2166136261u;  /* FNV-1a, see namehash() */
+  assert(name!=NULL);
+  assert(length>0);
+  while (length-->0) {
+    hash^=(unsigned char)*name++;
+    hash*=16777619u;
+  } /* while */
+  return &substhash[hash & (sSUBSTHASH-1)];
 }
 
 SC_FUNC stringpair *insert_subst(char *pattern,char *substitution,int prefixlen)
@@ -280,53 +309,60 @@ SC_FUNC stringpair *insert_subst(char *pattern,char *substitution,int prefixlen)
 
   assert(pattern!=NULL);
   assert(substitution!=NULL);
-  if ((cur=insert_stringpair(&substpair,pattern,substitution,prefixlen))==NULL)
+  if ((cur=insert_stringpair(substbucket(pattern,prefixlen),pattern,substitution,prefixlen))==NULL)
     error(103);       /* insufficient memory (fatal error) */
-  adjustindex(*pattern);
   return cur;
 }
 
+/* get_substbucket() returns the root of a list in the hash table, or NULL
+ * if the index is past the last bucket; this is for walking over all
+ * substitutions
+ */
+SC_FUNC stringpair *get_substbucket(int index)
+{
+  assert(index>=0);
+  return (index<sSUBSTHASH) ? &substhash[index] : NULL;
+}
+
 SC_FUNC stringpair *find_subst(char *name,int length)
 {
-  stringpair *item;
+  stringpair *root;
   assert(name!=NULL);
   assert(length>0);
   assert(*name>='A' && *name<='Z' || *name>='a' && *name<='z' || *name=='_' || *name==PUBLIC_CHAR);
-  item=substindex[(int)*name-PUBLIC_CHAR];
-  if (item!=NULL)
-    item=find_stringpair(item,name,length);
-  return item;
+  root=substbucket(name,length);
+  if (root->next==NULL)
+    return NULL;
+  return find_stringpair(root->next,name,length);
 }
 
 SC_FUNC int delete_subst(char *name,int length)
 {
-  stringpair *item;
+  stringpair *root,*item;
   assert(name!=NULL);
   assert(length>0);
   assert(*name>='A' && *name<='Z' || *name>='a' && *name<='z' || *name=='_' || *name==PUBLIC_CHAR);
-  item=substindex[(int)*name-PUBLIC_CHAR];
-  if (item!=NULL)
-    item=find_stringpair(item,name,length);
+  root=substbucket(name,length);
+  item=(root->next!=NULL) ? find_stringpair(root->next,name,length) : NULL;
   if (item==NULL)
     return FALSE;
-  delete_stringpair(&substpair,item);
-  adjustindex(*name);
+  delete_stringpair(root,item);
   return TRUE;
 }
 
 SC_FUNC void delete_substtable(void)
 {
   int i;
-  delete_stringpairtable(&substpair);
-  for (i=0; i<sizeof substindex/sizeof substindex[0]; i++)
-    substindex[i]=NULL;
+  for (i=0; i<sSUBSTHASH; i++)
+    if (substhash[i].next!=NULL)
+      delete_stringpairtable(&substhash[i]);
 }
 
 #endif /* !defined NO_SUBST */
 
 
 /* ----- input file list (explicit files) ------------------------ */
-static stringlist sourcefiles = {NULL, NULL};
+SC_VSTATIC stringlist sourcefiles = {NULL, NULL};
 
 SC_FUNC stringlist *insert_sourcefile(char *string)
 {
@@ -346,7 +382,7 @@ SC_FUNC void delete_sourcefiletable(void)
 
 
 /* ----- parsed file list (explicit + included files) ------------ */
-static stringlist inputfiles = {NULL, NULL};
+SC_VSTATIC stringlist inputfiles = {NULL, NULL};
 
 SC_FUNC stringlist *insert_inputfile(char *string)
 {
@@ -367,9 +403,37 @@ SC_FUNC void delete_inputfiletable(void)
 }
 
 
+/* ----- dependencies (included files and watched directories) --- */
+SC_VSTATIC stringlist dependencies = {NULL, NULL};
+
+SC_FUNC stringlist *insert_dependency(const char *filename)
+{
+  stringlist *cur;
+
+  assert(filename!=NULL);
+  if (sc_status==statWRITE || sc_status==statSKIP)
+    return NULL;                /* the list is complete after the first pass */
+  for (cur=dependencies.next; cur!=NULL; cur=cur->next)
+    if (strcmp(cur->line,filename)==0)
+      return cur;
+  return insert_string(&dependencies,(char*)filename,1);
+}
+
+SC_FUNC char *get_dependency(int index)
+{
+  return get_string(&dependencies,index);
+}
+
+SC_FUNC void delete_dependencytable(void)
+{
+  delete_stringtable(&dependencies);
+  assert(dependencies.next==NULL);
+}
+
+
 /* ----- documentation tags -------------------------------------- */
 #if !defined PAWN_LIGHT
-static stringlist docstrings = {NULL, NULL};
+SC_VSTATIC stringlist docstrings = {NULL, NULL};
 
 SC_FUNC stringlist *insert_docstring(char *string,int append)
 {
@@ -395,7 +459,7 @@ SC_FUNC void delete_docstringtable(void)
 
 
 /* ----- autolisting --------------------------------------------- */
-static stringlist autolist = {NULL, NULL};
+SC_VSTATIC stringlist autolist = {NULL, NULL};
 
 SC_FUNC stringlist *insert_autolist(char *string)
 {
@@ -415,7 +479,7 @@ SC_FUNC void delete_autolisttable(void)
 
 
 /* ----- heap usage list ----------------------------------------- */
-static valuepair heaplist = {NULL, 0, 0};
+SC_VSTATIC valuepair heaplist = {NULL, 0, 0};
 
 SC_FUNC valuepair *push_heaplist(long first, long second)
 {
@@ -487,7 +551,7 @@ SC_FUNC void delete_heaplisttable(void)
   #define PRIxC  "x"
 #endif
 
-static stringlist dbgstrings = {NULL, NULL};
+SC_VSTATIC stringlist dbgstrings = {NULL, NULL};
 
 SC_FUNC stringlist *insert_dbgfile(const char *filename)
 {
@@ -0,0 +1,1090 @@
+/*  Pawn compiler - precompiled prefix snapshots
+ *
+ *  The prefix file ("default.inc" or the file set with -p) and the files that
+ *  it includes are parsed at the start of every pass. For the common case that
+ *  these files only hold declarations (native functions, forward declarations,
+ *  constants, enumerations, tags and text substitutions), the state that they
+ *  leave behind can be saved to a file and restored in every pass, instead of
+ *  parsing the files again.
+ *
+ *  The snapshot is made from a separate parse of the prefix file alone, before
+ *  the first pass (see pc_compile()). It holds:
+ *  - a header with a hash of the compiler build, the cell size, the options
+ *    that affect the prefix (predefined constants, tags, include paths and a
+ *    few settings) and the names plus content hashes of all files read;
+ *  - the file switches, so that the file numbers and the debug information
+ *    are the same as when the prefix file is parsed;
+ *  - the settings changed by #pragma directives;
+ *  - the tag, library, automaton and state tables, and the aliases of native
+ *    functions;
+ *  - the text substitutions (#define);
+ *  - the global symbols that the prefix declared.
+ *
+ *  A snapshot is only valid for the same compiler build, the same options and
+ *  unchanged files; in all other cases, it is rebuilt. Files that appear later
+ *  in an include directory that comes earlier in the search path (or a file
+ *  that a #tryinclude failed to find) are not detected.
+ *
+ *  This software is provided "as-is", without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1.  The origin of this software must not be misrepresented; you must not
+ *      claim that you wrote the original software. If you use this software in
+ *      a product, an acknowledgment in the product documentation would be
+ *      appreciated but is not required.
+ *  2.  Altered source versions must be plainly marked as such, and must not be
+ *      misrepresented as being the original software.
+ *  3.  This notice may not be removed or altered from any source distribution.
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sc.h"
+#include "svnrev.h"
+
+#if defined FORTIFY
+  #include <alloc/fortify.h>
+#endif
+
+#define PCH_MAGIC     "PAWNPCH1"
+#define PCH_BUILDID   SVN_REVSTR " " __DATE__ " " __TIME__
+
+#define FNV64_BASIS   0xcbf29ce484222325uLL
+#define FNV64_PRIME   0x100000001b3uLL
+
+/* the snapshot, as it is stored in the file; it is built in memory and
+ * written when the compilation succeeds, or it is loaded from the file
+ */
+SC_VSTATIC unsigned char *image=NULL;
+SC_VSTATIC size_t imagesize=0;      /* bytes in use */
+SC_VSTATIC size_t imagetop=0;       /* bytes allocated */
+SC_VSTATIC size_t imagebody=0;      /* offset of the part that is applied per pass */
+SC_VSTATIC uint64_t ctxhash=0;      /* options at the start, see pch_load() */
+SC_VSTATIC uint64_t failedhash=0;   /* options for which no snapshot can be made */
+SC_VSTATIC int failedvalid=FALSE;
+
+/* cursor for reading the image */
+SC_VSTATIC const unsigned char *rdptr;
+SC_VSTATIC const unsigned char *rdend;
+SC_VSTATIC int rderror;
+
+/* the file switches during the parse of the prefix file */
+SC_VSTATIC stringlist filelog={NULL,NULL};
+SC_VSTATIC stringlist *filelogtail=NULL; /* NULL means &filelog */
+SC_VSTATIC int recording=FALSE;
+SC_VSTATIC int filedepth=0;
+
+static void log_file(char type,const char *name)
+{
+  stringlist *cur;
+  size_t len=strlen(name);
+
+  if ((cur=(stringlist*)malloc(sizeof(stringlist)))==NULL
+      || (cur->line=(char*)malloc(len+2))==NULL)
+    error(103);                 /* insufficient memory (fatal error) */
+  cur->line[0]=type;
+  memcpy(cur->line+1,name,len+1);
+  cur->next=NULL;
+  if (filelogtail==NULL)
+    filelogtail=&filelog;
+  filelogtail->next=cur;
+  filelogtail=cur;
+}
+
+static void delete_filelog(void)
+{
+  stringlist *cur,*next;
+
+  for (cur=filelog.next; cur!=NULL; cur=next) {
+    next=cur->next;
+    free(cur->line);
+    free(cur);
+  } /* for */
+  filelog.next=NULL;
+  filelogtail=&filelog;
+}
+
+static uint64_t hash_bytes(uint64_t hash,const void *data,size_t size)
+{
+  const unsigned char *ptr=(const unsigned char*)data;
+  while (size-->0) {
+    hash^=*ptr++;
+    hash*=FNV64_PRIME;
+  } /* while */
+  return hash;
+}
+
+static uint64_t hash_string(uint64_t hash,const char *string)
+{
+  return hash_bytes(hash,string,strlen(string)+1);  /* include the '\0' */
+}
+
+static uint64_t hash_int(uint64_t hash,cell value)
+{
+  return hash_bytes(hash,&value,sizeof value);
+}
+
+/* hash_file() returns FALSE if the file cannot be read */
+static int hash_file(const char *filename,uint64_t *hash)
+{
+  unsigned char line[sLINEMAX+1];
+  void *fp;
+
+  if ((fp=pc_opensrc((char*)filename))==NULL)
+    return FALSE;
+  *hash=FNV64_BASIS;
+  while (pc_readsrc(fp,line,sizeof line)!=NULL)
+    *hash=hash_bytes(*hash,line,strlen((char*)line));
+  pc_closesrc(fp);
+  return TRUE;
+}
+
+/* The context hash covers everything (apart from the files themselves) that
+ * may change how the prefix file is parsed.
+ */
+static uint64_t context_hash(const char *prefixname)
+{
+  uint64_t hash=FNV64_BASIS;
+  symbol *sym;
+  constvalue *tag;
+  char *path;
+  int i;
+
+  hash=hash_string(hash,PCH_BUILDID);
+  hash=hash_int(hash,sizeof(cell));
+  hash=hash_string(hash,prefixname);
+  for (i=0; (path=get_path(i))!=NULL; i++)
+    hash=hash_string(hash,path);
+  /* predefined constants and constants set on the command line */
+  for (sym=glbtab.next; sym!=NULL; sym=sym->next) {
+    if (sym->ident==iCONSTEXPR && (sym->usage & uPREDEF)!=0) {
+      hash=hash_string(hash,sym->name);
+      hash=hash_int(hash,sym->addr);
+      hash=hash_int(hash,sym->tag);
+    } /* if */
+  } /* for */
+  for (tag=tagname_tab.next; tag!=NULL; tag=tag->next) {
+    hash=hash_string(hash,tag->name);
+    hash=hash_int(hash,tag->value);
+  } /* for */
+  hash=hash_int(hash,sc_ctrlchar);
+  hash=hash_int(hash,sc_packstr);
+  hash=hash_int(hash,sc_needsemicolon);
+  hash=hash_int(hash,pc_tabsize);
+  hash=hash_int(hash,pc_matchedtabsize);
+  hash=hash_int(hash,sc_debug);
+  return hash;
+}
+
+/* ----- writing the image --------------------------------------- */
+static void put_bytes(const void *data,size_t size)
+{
+  if (imagesize+size>imagetop) {
+    size_t newtop=(imagetop==0) ? 4096 : 2*imagetop;
+    unsigned char *newimage;
+    while (newtop<imagesize+size)
+      newtop*=2;
+    if ((newimage=(unsigned char*)realloc(image,newtop))==NULL)
+      error(103);               /* insufficient memory */
+    image=newimage;
+    imagetop=newtop;
+  } /* if */
+  memcpy(image+imagesize,data,size);
+  imagesize+=size;
+}
+
+static void put_int(long value)
+{
+  int32_t v=(int32_t)value;
+  put_bytes(&v,sizeof v);
+}
+
+static void put_cell(cell value)
+{
+  put_bytes(&value,sizeof value);
+}
+
+static void put_hash(uint64_t value)
+{
+  put_bytes(&value,sizeof value);
+}
+
+static void put_string(const char *string)
+{
+  if (string==NULL) {
+    put_int(-1);
+  } else {
+    size_t len=strlen(string);
+    put_int((long)len);
+    put_bytes(string,len);
+  } /* if */
+}
+
+static void put_consttable(const constvalue *table)
+{
+  const constvalue *cur;
+  int count=0;
+
+  for (cur=table->next; cur!=NULL; cur=cur->next)
+    count++;
+  put_int(count);
+  for (cur=table->next; cur!=NULL; cur=cur->next) {
+    put_string(cur->name);
+    put_cell(cur->value);
+    put_int(cur->index);
+  } /* for */
+}
+
+static void put_arglist(const arginfo *arglist)
+{
+  const arginfo *arg;
+  int count,i;
+
+  for (count=0; arglist[count].ident!=0; count++)
+    /* nothing */;
+  put_int(count);
+  for (arg=arglist; arg->ident!=0; arg++) {
+    put_string(arg->name);
+    put_int(arg->ident);
+    put_int(arg->usage);
+    put_int(arg->numtags);
+    for (i=0; i<arg->numtags; i++)
+      put_int(arg->tags[i]);
+    put_int(arg->numdim);
+    for (i=0; i<arg->numdim; i++) {
+      put_int(arg->dim[i]);
+      put_int(arg->idxtag[i]);
+    } /* for */
+    put_int(arg->hasdefault);
+    put_int(arg->defvalue_tag);
+    if (arg->ident==iREFARRAY && arg->hasdefault) {
+      put_int(arg->defvalue.array.size);
+      put_int(arg->defvalue.array.arraysize);
+      put_cell(arg->defvalue.array.addr);
+      put_bytes(arg->defvalue.array.data,arg->defvalue.array.size*sizeof(cell));
+    } else if (arg->ident==iVARIABLE && (arg->hasdefault & (uSIZEOF | uTAGOF))!=0) {
+      put_string(arg->defvalue.size.symname);
+      put_int(arg->defvalue.size.level);
+    } else {
+      put_cell(arg->defvalue.val);
+    } /* if */
+  } /* for */
+}
+
+/* Only declarations can be restored from a snapshot; anything that generates
+ * code or data, or that has states, makes the prefix unfit for a snapshot.
+ */
+static int is_declaration(const symbol *sym)
+{
+  if (sym->states!=NULL)
+    return FALSE;
+  switch (sym->ident) {
+  case iCONSTEXPR:
+    return TRUE;
+  case iFUNCTN:
+    if ((sym->usage & uNATIVE)!=0)
+      return TRUE;
+    return (sym->usage & uFORWARD)!=0 && (sym->usage & uDEFINE)==0;
+  case iREFARRAY:
+    /* array returned by a native or forward function */
+    while (sym->parent!=NULL && sym->parent->ident==iREFARRAY)
+      sym=sym->parent;
+    return sym->parent!=NULL && is_declaration(sym->parent);
+  } /* switch */
+  return FALSE;
+}
+
+/* the index of every stored symbol, sorted on the address of the symbol, for
+ * looking up the parent of a symbol
+ */
+typedef struct s_symindex {
+  const symbol *sym;
+  int index;
+} symindex;
+
+static int cmp_symindex(const void *a,const void *b)
+{
+  size_t sym1=(size_t)((const symindex*)a)->sym;
+  size_t sym2=(size_t)((const symindex*)b)->sym;
+  return (sym1<sym2) ? -1 : (sym1>sym2) ? 1 : 0;
+}
+
+static int must_store(const symbol *sym)
+{
+  if (sym->ident==iCONSTEXPR && (sym->usage & uPREDEF)!=0)
+    return FALSE;               /* set before the prefix file was read */
+  if (strcmp(sym->name,"__line")==0)
+    return FALSE;               /* updated on every line */
+  return TRUE;
+}
+
+/*  pch_startrecord, pch_filepush, pch_filepop, pch_filewatch
+ *
+ *  While the prefix file is parsed for a snapshot, all file switches are
+ *  logged: an entry with the file name when a file is included, and an entry
+ *  with the name of the file that is resumed after the end of an include file
+ *  (or an empty string when returning to the main source file), and the
+ *  directories to watch for a file that #tryinclude did not find.
+ */
+SC_FUNC void pch_startrecord(int start)
+{
+  if (start) {
+    delete_filelog();
+    filedepth=0;
+  } /* if */
+  recording=start;
+}
+
+SC_FUNC int pch_recording(void)
+{
+  return recording;
+}
+
+SC_FUNC void pch_filepush(const char *name)
+{
+  if (recording) {
+    log_file('+',name);
+    filedepth++;
+  } /* if */
+}
+
+SC_FUNC void pch_filewatch(const char *name)
+{
+  if (recording)
+    log_file('?',name);
+}
+
+SC_FUNC void pch_filepop(const char *name)
+{
+  if (recording) {
+    assert(filedepth>0);
+    log_file('-',(--filedepth>0) ? name : "");
+  } /* if */
+}
+
+/*  pch_create
+ *
+ *  Builds a snapshot (in memory) from the state after parsing the prefix file.
+ *  Returns FALSE if the prefix file holds more than declarations. A call to
+ *  pch_load() must precede this call, for the hash on the options.
+ */
+SC_FUNC int pch_create(void)
+{
+  symbol *sym,**symlist;
+  symindex *symmap;
+  stringlist *entry;
+  int count,filecount,i,idx;
+  #if !defined NO_DEFINE
+    stringpair *root,*item;
+  #endif
+
+  assert(image==NULL);          /* pch_load() clears any previous snapshot */
+  assert(!recording);
+  failedvalid=FALSE;
+  count=0;
+  for (sym=glbtab.next; sym!=NULL && count>=0; sym=sym->next) {
+    if (!must_store(sym))
+      continue;
+    if (!is_declaration(sym))
+      count=-1;
+    else
+      count++;
+  } /* for */
+  if (code_idx!=0 || glb_declared!=0 || count<0) {
+    failedhash=ctxhash;
+    failedvalid=TRUE;
+    return FALSE;
+  } /* if */
+  symlist=(symbol**)malloc((count+1)*sizeof(symbol*));
+  symmap=(symindex*)malloc((count+1)*sizeof(symindex));
+  if (symlist==NULL || symmap==NULL) {
+    free(symlist);
+    free(symmap);
+    return FALSE;
+  } /* if */
+  idx=0;
+  for (sym=glbtab.next; sym!=NULL; sym=sym->next) {
+    if (must_store(sym)) {
+      symmap[idx].sym=sym;
+      symmap[idx].index=idx;
+      symlist[idx++]=sym;
+    } /* if */
+  } /* for */
+  assert(idx==count);
+  qsort(symmap,idx,sizeof(symindex),cmp_symindex);
+
+  /* header */
+  put_bytes(PCH_MAGIC,8);
+  put_hash(ctxhash);
+  filecount=0;
+  for (entry=filelog.next; entry!=NULL; entry=entry->next)
+    if (entry->line[0]=='+')
+      filecount++;
+  put_int(filecount);
+  for (entry=filelog.next; entry!=NULL; entry=entry->next) {
+    uint64_t hash;
+    if (entry->line[0]!='+')
+      continue;
+    if (!hash_file(entry->line+1,&hash)) {
+      free(symlist);
+      free(symmap);
+      pch_delete();
+      return FALSE;
+    } /* if */
+    put_string(entry->line+1);
+    put_hash(hash);
+  } /* for */
+  imagebody=imagesize;
+
+  /* file switches */
+  count=0;
+  for (entry=filelog.next; entry!=NULL; entry=entry->next)
+    count++;
+  put_int(count);
+  for (entry=filelog.next; entry!=NULL; entry=entry->next)
+    put_string(entry->line);
+
+  /* settings that #pragma directives may have changed */
+  put_int(sc_ctrlchar);
+  put_int(sc_packstr);
+  put_int(sc_needsemicolon);
+  put_int(pc_tabsize);
+  put_int(pc_matchedtabsize);
+  put_int(sc_rationaltag);
+  put_int(rational_digits);
+  put_cell(pc_stksize);
+  put_cell(pc_amxlimit);
+  put_cell(pc_amxram);
+  put_int(pc_compress);
+  put_int(pc_overlays);
+  put_int(pc_addlibtable);
+  put_int(sc_alignnext);
+
+  /* tables */
+  put_consttable(&tagname_tab);
+  put_consttable(&libname_tab);
+  put_consttable(&sc_automaton_tab);
+  put_consttable(&sc_state_tab);
+
+  /* text substitutions */
+  #if !defined NO_DEFINE
+    count=0;
+    for (i=0; (root=get_substbucket(i))!=NULL; i++)
+      for (item=root->next; item!=NULL; item=item->next)
+        count++;
+    put_int(count);
+    for (i=0; (root=get_substbucket(i))!=NULL; i++) {
+      for (item=root->next; item!=NULL; item=item->next) {
+        put_string(item->first);
+        put_string(item->second);
+      } /* for */
+    } /* for */
+  #else
+    put_int(0);
+  #endif
+
+  /* symbols, in the order of the symbol table */
+  put_int(idx);
+  for (i=0; i<idx; i++) {
+    int parent=-1;
+    sym=symlist[i];
+    if (sym->parent!=NULL) {
+      symindex key,*found;
+      key.sym=sym->parent;
+      found=(symindex*)bsearch(&key,symmap,idx,sizeof(symindex),cmp_symindex);
+      assert(found!=NULL);
+      parent=found->index;
+    } /* if */
+    put_string(sym->name);
+    put_int(sym->ident);
+    put_int(sym->vclass);
+    put_int(sym->usage);
+    put_int(sym->flags);
+    put_int(sym->tag);
+    put_int(sym->index);
+    put_int(sym->fvisible);
+    put_int(sym->fnumber);
+    put_int(sym->lnumber);
+    put_int(parent);
+    put_cell(sym->addr);
+    put_cell(sym->codeaddr);
+    put_string(sym->documentation);
+    switch (sym->ident) {
+    case iCONSTEXPR:
+      put_int(sym->x.tags.index);
+      put_int(sym->x.tags.field);
+      if ((sym->usage & uENUMROOT)!=0) {
+        assert(sym->dim.enumlist!=NULL);
+        put_consttable(sym->dim.enumlist);
+      } else {
+        put_cell(sym->dim.array.length);
+        put_int(sym->dim.array.level);
+      } /* if */
+      break;
+    case iFUNCTN:
+      if ((sym->usage & uNATIVE)!=0) {
+        char alias[sNAMEMAX+1];
+        put_string((sym->x.lib!=NULL) ? sym->x.lib->name : NULL);
+        put_string(lookup_alias(alias,sym->name) ? alias : NULL);
+      } else {
+        put_cell((cell)sym->x.stacksize);
+      } /* if */
+      put_arglist(sym->dim.arglist);
+      break;
+    case iREFARRAY:
+      put_int(sym->x.tags.index);
+      put_cell(sym->dim.array.length);
+      put_int(sym->dim.array.level);
+      break;
+    default:
+      assert(0);
+    } /* switch */
+  } /* for */
+  free(symlist);
+  free(symmap);
+  return TRUE;
+}
+
+/*  pch_save
+ *
+ *  Writes a snapshot that was made with pch_create(). The snapshot is written
+ *  to a temporary file that is then renamed, so that a concurrent compile
+ *  never reads a partially written file.
+ */
+SC_FUNC int pch_save(const char *filename)
+{
+  char tmpname[_MAX_PATH];
+  FILE *fp;
+  int ok;
+
+  if (image==NULL || imagebody==0)
+    return FALSE;
+  if ((fp=tempfile_open(tmpname,sizeof tmpname,filename))==NULL)
+    return FALSE;
+  ok=fwrite(image,1,imagesize,fp)==imagesize;
+  if (fclose(fp)!=0)
+    ok=FALSE;
+  if (ok)
+    ok=tempfile_commit(tmpname,filename);
+  else
+    remove(tmpname);
+  return ok;
+}
+
+SC_FUNC void pch_delete(void)
+{
+  if (image!=NULL)
+    free(image);
+  image=NULL;
+  imagesize=imagetop=imagebody=0;
+  delete_filelog();
+}
+
+/* ----- reading the image --------------------------------------- */
+static void get_bytes(void *data,size_t size)
+{
+  if (rderror || (size_t)(rdend-rdptr)<size) {
+    rderror=TRUE;
+    memset(data,0,size);
+    return;
+  } /* if */
+  memcpy(data,rdptr,size);
+  rdptr+=size;
+}
+
+static long get_int(void)
+{
+  int32_t v;
+  get_bytes(&v,sizeof v);
+  return v;
+}
+
+static cell get_cell(void)
+{
+  cell v;
+  get_bytes(&v,sizeof v);
+  return v;
+}
+
+static uint64_t get_hash(void)
+{
+  uint64_t v;
+  get_bytes(&v,sizeof v);
+  return v;
+}
+
+/* get_string() copies the string into "buffer" when it fits, and returns
+ * NULL for a NULL string; with a NULL buffer, it returns an allocated copy
+ */
+static char *get_string(char *buffer,size_t size)
+{
+  long len=get_int();
+  char *string;
+
+  if (len<0 || rderror)
+    return NULL;
+  if ((size_t)(rdend-rdptr)<(size_t)len) {
+    rderror=TRUE;
+    return NULL;
+  } /* if */
+  if (buffer==NULL) {
+    if ((string=(char*)malloc(len+1))==NULL)
+      error(103);               /* insufficient memory */
+  } else {
+    if ((size_t)len>=size) {
+      rderror=TRUE;
+      return NULL;
+    } /* if */
+    string=buffer;
+  } /* if */
+  memcpy(string,rdptr,len);
+  string[len]='\0';
+  rdptr+=len;
+  return string;
+}
+
+static int check_body(void);
+
+/* check_image() verifies the header of the snapshot: the options and the
+ * contents of the files must be the same as when it was made; it also reads
+ * through the body (see check_body())
+ */
+static int check_image(void)
+{
+  int count,ok;
+
+  assert(image!=NULL);
+  if (imagesize<8 || memcmp(image,PCH_MAGIC,8)!=0)
+    return FALSE;
+  rdptr=image+8;
+  rdend=image+imagesize;
+  rderror=FALSE;
+  ok=get_hash()==ctxhash;
+  for (count= ok ? get_int() : 0; ok && count>0; count--) {
+    char name[_MAX_PATH];
+    uint64_t hash,current;
+    if (get_string(name,sizeof name)==NULL)
+      ok=FALSE;
+    hash=get_hash();
+    if (ok && (rderror || !hash_file(name,&current) || current!=hash))
+      ok=FALSE;
+  } /* for */
+  if (!ok || rderror)
+    return FALSE;
+  imagebody=(size_t)(rdptr-image);
+  return check_body();
+}
+
+/*  pch_load
+ *
+ *  Reads a snapshot and checks whether it is valid for the current options
+ *  and the current contents of the files. On success, the snapshot is kept
+ *  for pch_apply(). Without a filename, the function checks the snapshot
+ *  that an earlier compile left in memory (batch mode).
+ */
+SC_FUNC int pch_load(const char *filename,const char *prefixname)
+{
+  FILE *fp;
+  long length;
+  int ok;
+
+  /* the hash must be taken before the prefix file is parsed (for a new
+   * snapshot), because the prefix file adds to the tag table
+   */
+  ctxhash=context_hash(prefixname);
+  if (filename==NULL || *filename=='\0') {
+    if (image!=NULL && imagebody>0 && check_image())
+      return TRUE;
+    pch_delete();
+    return FALSE;
+  } /* if */
+
+  pch_delete();
+  if ((fp=fopen(filename,"rb"))==NULL)
+    return FALSE;
+  ok=FALSE;
+  if (fseek(fp,0,SEEK_END)==0 && (length=ftell(fp))>8 && fseek(fp,0,SEEK_SET)==0) {
+    if ((image=(unsigned char*)malloc(length))!=NULL) {
+      imagesize=imagetop=(size_t)length;
+      ok=fread(image,1,imagesize,fp)==imagesize;
+    } /* if */
+  } /* if */
+  fclose(fp);
+  if (ok && check_image())
+    return TRUE;
+  pch_delete();
+  return FALSE;
+}
+
+/*  pch_failed
+ *
+ *  Returns TRUE if an earlier attempt to make a snapshot for the same options
+ *  failed, because the prefix file holds more than declarations. This avoids
+ *  parsing the prefix file twice for every compile in batch mode.
+ */
+SC_FUNC int pch_failed(void)
+{
+  return failedvalid && failedhash==ctxhash;
+}
+
+/* apply_consttable() adds the constants to the table; with a NULL table, it
+ * only skips over the list
+ */
+static void apply_consttable(constvalue *table)
+{
+  int count=(int)get_int();
+
+  while (count-->0 && !rderror) {
+    char name[sNAMEMAX+1];
+    cell value;
+    int index;
+    get_string(name,sizeof name);
+    value=get_cell();
+    index=(int)get_int();
+    if (!rderror && table!=NULL && find_constval(table,name,index)==NULL)
+      append_constval(table,name,value,index);
+  } /* while */
+}
+
+static void free_arglist(arginfo *arglist)
+{
+  arginfo *arg;
+
+  for (arg=arglist; arg->ident!=0; arg++) {
+    if (arg->ident==iREFARRAY && arg->hasdefault)
+      free(arg->defvalue.array.data);
+    else if (arg->ident==iVARIABLE && (arg->hasdefault & (uSIZEOF | uTAGOF))!=0)
+      free(arg->defvalue.size.symname);
+    free(arg->tags);
+  } /* for */
+  free(arglist);
+}
+
+static arginfo *get_arglist(void)
+{
+  arginfo *arglist,*arg;
+  int count,i;
+
+  count=(int)get_int();
+  if (count<0 || rderror)
+    count=0;
+  if ((arglist=(arginfo*)malloc((count+1)*sizeof(arginfo)))==NULL)
+    error(103);                 /* insufficient memory */
+  memset(arglist,0,(count+1)*sizeof(arginfo));
+  for (arg=arglist; count>0; arg++,count--) {
+    get_string(arg->name,sizeof arg->name);
+    arg->ident=(char)get_int();
+    arg->usage=(char)get_int();
+    arg->numtags=(int)get_int();
+    if (arg->numtags<0 || rderror)
+      arg->numtags=0;
+    if ((arg->tags=(int*)malloc((arg->numtags+1)*sizeof(int)))==NULL)
+      error(103);               /* insufficient memory */
+    for (i=0; i<arg->numtags; i++)
+      arg->tags[i]=(int)get_int();
+    arg->numdim=(int)get_int();
+    if (arg->numdim<0 || arg->numdim>sDIMEN_MAX)
+      rderror=TRUE;
+    for (i=0; i<arg->numdim && !rderror; i++) {
+      arg->dim[i]=(int)get_int();
+      arg->idxtag[i]=(int)get_int();
+    } /* for */
+    arg->hasdefault=(unsigned char)get_int();
+    arg->defvalue_tag=(int)get_int();
+    if (arg->ident==iREFARRAY && arg->hasdefault) {
+      int size=(int)get_int();
+      if (size<0 || rderror)
+        size=0;
+      arg->defvalue.array.size=size;
+      arg->defvalue.array.arraysize=(int)get_int();
+      arg->defvalue.array.addr=get_cell();
+      if ((arg->defvalue.array.data=(cell*)malloc((size+1)*sizeof(cell)))==NULL)
+        error(103);             /* insufficient memory */
+      get_bytes(arg->defvalue.array.data,size*sizeof(cell));
+    } else if (arg->ident==iVARIABLE && (arg->hasdefault & (uSIZEOF | uTAGOF))!=0) {
+      arg->defvalue.size.symname=get_string(NULL,0);
+      if (arg->defvalue.size.symname==NULL)
+        arg->defvalue.size.symname=duplicatestring("");
+      arg->defvalue.size.level=(short)get_int();
+    } else {
+      arg->defvalue.val=get_cell();
+    } /* if */
+  } /* for */
+  return arglist;
+}
+
+/* read_symbol() reads a symbol record; it creates the symbol if "create" is
+ * set, and only skips over the record otherwise
+ */
+static symbol *read_symbol(int create,char *name,int *ident,int *usage,int *parent)
+{
+  int vclass,flags,tag;
+  symbol *sym=NULL;
+
+  get_string(name,sNAMEMAX+1);
+  *ident=(int)get_int();
+  vclass=(int)get_int();
+  *usage=(int)get_int();
+  flags=(int)get_int();
+  tag=(int)get_int();
+  if (create && !rderror) {
+    sym=addsym(name,0,*ident,vclass,tag,0);
+    assert(sym!=NULL);          /* fatal error 103 must be given on error */
+    sym->usage=(short)*usage;
+    sym->flags=(char)flags;
+  } /* if */
+  if (sym!=NULL) {
+    sym->index=(int)get_int();
+    sym->fvisible=(int)get_int();
+    sym->fnumber=(int)get_int();
+    sym->lnumber=(int)get_int();
+  } else {
+    get_int();
+    get_int();
+    get_int();
+    get_int();
+  } /* if */
+  *parent=(int)get_int();
+  if (sym!=NULL) {
+    sym->addr=get_cell();
+    sym->codeaddr=get_cell();
+    sym->documentation=get_string(NULL,0);
+  } else {
+    get_cell();
+    get_cell();
+    free(get_string(NULL,0));
+  } /* if */
+
+  switch (*ident) {
+  case iCONSTEXPR: {
+    int index=(int)get_int();
+    int field=(int)get_int();
+    if ((*usage & uENUMROOT)!=0) {
+      constvalue enumlist;
+      memset(&enumlist,0,sizeof enumlist);
+      apply_consttable(&enumlist);
+      if (sym!=NULL) {
+        if ((sym->dim.enumlist=(constvalue*)malloc(sizeof(constvalue)))==NULL)
+          error(103);           /* insufficient memory (fatal error) */
+        *sym->dim.enumlist=enumlist;
+      } else {
+        delete_consttable(&enumlist);
+      } /* if */
+    } else {
+      cell length=get_cell();
+      int level=(int)get_int();
+      if (sym!=NULL) {
+        sym->dim.array.length=length;
+        sym->dim.array.level=(short)level;
+      } /* if */
+    } /* if */
+    if (sym!=NULL) {
+      sym->x.tags.index=index;
+      sym->x.tags.field=field;
+    } /* if */
+    break;
+  } /* case */
+  case iFUNCTN: {
+    arginfo *arglist;
+    if ((*usage & uNATIVE)!=0) {
+      char libname[sNAMEMAX+1],alias[sNAMEMAX+1];
+      int haslib=get_string(libname,sizeof libname)!=NULL;
+      int hasalias=get_string(alias,sizeof alias)!=NULL;
+      if (sym!=NULL) {
+        sym->x.lib=haslib ? find_constval(&libname_tab,libname,0) : NULL;
+        if (hasalias)
+          insert_alias(sym->name,alias);
+      } /* if */
+    } else {
+      long stacksize=(long)get_cell();
+      if (sym!=NULL)
+        sym->x.stacksize=stacksize;
+    } /* if */
+    arglist=get_arglist();
+    if (sym!=NULL)
+      sym->dim.arglist=arglist;
+    else
+      free_arglist(arglist);
+    break;
+  } /* case */
+  case iREFARRAY: {
+    int index=(int)get_int();
+    cell length=get_cell();
+    int level=(int)get_int();
+    if (sym!=NULL) {
+      sym->x.tags.index=index;
+      sym->dim.array.length=length;
+      sym->dim.array.level=(short)level;
+    } /* if */
+    break;
+  } /* case */
+  default:
+    rderror=TRUE;
+  } /* switch */
+  return sym;
+}
+
+/* check_body() reads through the part of the snapshot that pch_apply()
+ * restores, without changing anything. A damaged or truncated snapshot is
+ * thus rejected before pch_apply() has changed part of the state, and the
+ * prefix file is parsed instead.
+ */
+static int check_body(void)
+{
+  char name[_MAX_PATH+2];
+  int count,ident,usage,parent,symcount;
+
+  for (count=(int)get_int(); count>0 && !rderror; count--)
+    if (get_string(name,sizeof name)==NULL)
+      rderror=TRUE;
+  for (count=0; count<11; count++)
+    get_int();                  /* settings of #pragma directives */
+  for (count=0; count<3; count++)
+    get_cell();
+  for (count=0; count<4; count++)
+    apply_consttable(NULL);     /* tag, library, automaton and state tables */
+  for (count=(int)get_int(); count>0 && !rderror; count--) {
+    free(get_string(NULL,0));   /* text substitutions */
+    free(get_string(NULL,0));
+  } /* for */
+  symcount=(int)get_int();
+  if (symcount<0)
+    rderror=TRUE;
+  for (count=0; count<symcount && !rderror; count++) {
+    read_symbol(FALSE,name,&ident,&usage,&parent);
+    if (parent>=symcount || parent<-1)
+      rderror=TRUE;
+  } /* for */
+  return !rderror && rdptr==rdend;
+}
+
+/*  pch_apply
+ *
+ *  Restores the state that the prefix file leaves behind; this replaces the
+ *  call to plungeprefix() in every pass. Functions that were declared
+ *  "forward" survive from the previous pass and are kept as they are.
+ */
+SC_FUNC void pch_apply(void)
+{
+  const unsigned char **records;
+  symbol **created;
+  int *parents;
+  char *skip;
+  int count,i,changed;
+
+  assert(image!=NULL && imagebody>0);
+  rdptr=image+imagebody;
+  rdend=image+imagesize;
+  rderror=FALSE;
+
+  /* replay the file switches, for the file numbers and the debug info */
+  for (count=(int)get_int(); count>0 && !rderror; count--) {
+    char name[_MAX_PATH+2];
+    if (get_string(name,sizeof name)==NULL)
+      break;
+    if (name[0]=='+') {
+      fnumber++;
+      insert_dbgfile(name+1);
+      insert_inputfile(name+1);
+      insert_dependency(name+1);
+    } else if (name[0]=='?') {
+      insert_dependency(name+1);
+    } else {
+      insert_dbgfile((name[1]!='\0') ? name+1 : inpfname);
+    } /* if */
+  } /* for */
+
+  sc_ctrlchar=(char)get_int();
+  sc_packstr=(int)get_int();
+  sc_needsemicolon=(int)get_int();
+  pc_tabsize=(int)get_int();
+  pc_matchedtabsize=(int)get_int();
+  sc_rationaltag=(int)get_int();
+  rational_digits=(int)get_int();
+  pc_stksize=get_cell();
+  pc_amxlimit=get_cell();
+  pc_amxram=get_cell();
+  pc_compress=(int)get_int();
+  pc_overlays=(int)get_int();
+  pc_addlibtable=(int)get_int();
+  sc_alignnext=(int)get_int();
+
+  apply_consttable(&tagname_tab);
+  apply_consttable(&libname_tab);
+  apply_consttable(&sc_automaton_tab);
+  apply_consttable(&sc_state_tab);
+
+  for (count=(int)get_int(); count>0 && !rderror; count--) {
+    char *pattern=get_string(NULL,0);
+    char *substitution=get_string(NULL,0);
+    #if !defined NO_DEFINE
+      if (pattern!=NULL && substitution!=NULL) {
+        int prefixlen;
+        for (prefixlen=0; alphanum(pattern[prefixlen]); prefixlen++)
+          /* nothing */;
+        if (prefixlen>0)
+          insert_subst(pattern,substitution,prefixlen);
+      } /* if */
+    #endif
+    if (pattern!=NULL)
+      free(pattern);
+    if (substitution!=NULL)
+      free(substitution);
+  } /* for */
+
+  /* locate the symbol records first, so that the symbols can be created in
+   * reverse order: add_symbol() puts a new symbol in front of the symbols
+   * with the same name, and the order in the table must be as it was
+   */
+  count=(int)get_int();
+  if (count<0 || rderror)
+    count=0;
+  records=(const unsigned char**)malloc((count+1)*sizeof(unsigned char*));
+  created=(symbol**)malloc((count+1)*sizeof(symbol*));
+  parents=(int*)malloc((count+1)*sizeof(int));
+  skip=(char*)malloc(count+1);
+  if (records==NULL || created==NULL || parents==NULL || skip==NULL)
+    error(103);                 /* insufficient memory (fatal error) */
+  for (i=0; i<count && !rderror; i++) {
+    char name[sNAMEMAX+1];
+    int ident,usage;
+    records[i]=rdptr;
+    created[i]=NULL;
+    read_symbol(FALSE,name,&ident,&usage,&parents[i]);
+    if (parents[i]>=count || parents[i]<-1)
+      rderror=TRUE;
+    skip[i]=(char)(ident==iFUNCTN && (usage & uNATIVE)==0 && findglb(name,sGLOBAL)!=NULL);
+  } /* for */
+  do {
+    /* sub-symbols of a function that is kept, are kept too */
+    changed=FALSE;
+    for (i=0; i<count && !rderror; i++) {
+      if (!skip[i] && parents[i]>=0 && skip[parents[i]]) {
+        skip[i]=TRUE;
+        changed=TRUE;
+      } /* if */
+    } /* for */
+  } while (changed);
+  for (i=count-1; i>=0 && !rderror; i--) {
+    char name[sNAMEMAX+1];
+    int ident,usage,parent;
+    if (!skip[i]) {
+      rdptr=records[i];
+      created[i]=read_symbol(TRUE,name,&ident,&usage,&parent);
+    } /* if */
+  } /* for */
+  for (i=0; i<count && !rderror; i++)
+    if (created[i]!=NULL && parents[i]>=0 && created[parents[i]]!=NULL)
+      setparent(created[i],created[parents[i]]);
+  free(records);
+  free(created);
+  free(parents);
+  free(skip);
+  assert(!rderror);             /* pch_load() checked the snapshot */
+}
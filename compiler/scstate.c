@@ -64,7 +64,7 @@ typedef struct s_statepool {
   int listid;           /* unique id for this combination list */
 } statepool;
 
-static statepool statepool_tab = { NULL, NULL, 0, 0, 0};   /* state combinations table */
+SC_VSTATIC statepool statepool_tab = { NULL, NULL, 0, 0, 0};   /* state combinations table */
 
 
 static constvalue *find_automaton(const char *name,int *last,char *closestmatch)
@@ -62,6 +62,7 @@ SC_VDEFINE int sc_debug  = sCHKBOUNDS; /* by default: bounds checking+assertions
 SC_VDEFINE int sc_packstr= FALSE;  /* strings are packed by default? */
 SC_VDEFINE int sc_asmfile= FALSE;  /* create .ASM file? */
 SC_VDEFINE int sc_listing= FALSE;  /* create .LST file? */
+SC_VDEFINE int sc_expandonly=FALSE;/* preprocess only, do not parse (implies sc_listing) */
 SC_VDEFINE int pc_compress=TRUE;   /* compress bytecode? */
 SC_VDEFINE int sc_needsemicolon=TRUE;/* semicolon required to terminate expressions? */
 SC_VDEFINE int sc_dataalign=sizeof(cell);/* data alignment value */
@@ -75,6 +76,7 @@ SC_VDEFINE int freading  = FALSE;  /* Is there an input file ready for reading?
 SC_VDEFINE int fline     = 0;      /* the line number in the current file */
 SC_VDEFINE short fnumber = 0;      /* the file number in the file table (debugging) */
 SC_VDEFINE short fcurrent= 0;      /* current file being processed (debugging) */
+SC_VDEFINE short fscope  = 0;      /* file number for the scope of "static" symbols */
 SC_VDEFINE short sc_intest=FALSE;  /* true if inside a test */
 SC_VDEFINE int pc_sideeffect=0;    /* true if an expression causes a side-effect */
 SC_VDEFINE int pc_stmtindent=0;    /* current indent of the statement */
@@ -99,6 +101,7 @@ SC_VDEFINE constvalue sc_state_tab = { NULL, "", 0, 0};   /* state table */
 
 SC_VDEFINE FILE *inpf    = NULL;   /* file read from (source or include) */
 SC_VDEFINE FILE *inpf_org= NULL;   /* main source file */
+SC_VDEFINE int inpf_index= 0;      /* index of the main source file being read */
 SC_VDEFINE FILE *outf    = NULL;   /* (intermediate) text file written to */
 
 SC_VDEFINE jmp_buf errbuf;
@@ -0,0 +1,17 @@
+#include <lib>
+
+new total;
+
+sum(limit)
+{
+    new s = 0;
+    for (new i = 1; i <= limit; i++)
+        s += SQUARE(i);
+    return s;
+}
+
+main()
+{
+    total = sum(LIMIT);
+    printf("sum = %d\n", total);
+}
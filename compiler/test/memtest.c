@@ -0,0 +1,110 @@
+/*  Pawn compiler - smoke test for pc_compilememory()
+ *
+ *  Usage: pawnc-memtest <output> [options] <source> [source...]
+ *
+ *  Reads the source files into memory and compiles them with
+ *  pc_compilememory(); include files are passed in through the resolver.
+ *  The output file is written from the memory image, so that it can be
+ *  compared with the output of a normal compile.
+ *
+ *  This software is provided "as-is", without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1.  The origin of this software must not be misrepresented; you must not
+ *      claim that you wrote the original software. If you use this software in
+ *      a product, an acknowledgment in the product documentation would be
+ *      appreciated but is not required.
+ *  2.  Altered source versions must be plainly marked as such, and must not be
+ *      misrepresented as being the original software.
+ *  3.  This notice may not be removed or altered from any source distribution.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../sc.h"
+
+#define MAXFILES  32
+
+static char *filetext[MAXFILES];
+static int numfiles=0;
+
+static char *readfile(const char *filename,long *length)
+{
+  char *text;
+  long size;
+  FILE *fp;
+
+  if ((fp=fopen(filename,"rb"))==NULL)
+    return NULL;
+  fseek(fp,0,SEEK_END);
+  size=ftell(fp);
+  fseek(fp,0,SEEK_SET);
+  if (numfiles>=MAXFILES || (text=(char*)malloc(size+1))==NULL) {
+    fclose(fp);
+    return NULL;
+  } /* if */
+  *length=(long)fread(text,1,size,fp);
+  text[*length]='\0';
+  fclose(fp);
+  filetext[numfiles++]=text;
+  return text;
+}
+
+static int resolver(void *userdata,const char *name,const char **text,long *length)
+{
+  (void)userdata;
+  *text=readfile(name,length);
+  return *text!=NULL;
+}
+
+int main(int argc,char *argv[])
+{
+  PC_SOURCE sources[MAXFILES];
+  char *options[MAXFILES+1];
+  int numsources,numoptions,arg,retcode;
+  unsigned char *image;
+  long size;
+  FILE *fp;
+
+  if (argc<3) {
+    printf("Usage: pawnc-memtest <output> [options] <source> [source...]\n");
+    return 1;
+  } /* if */
+  numsources=numoptions=0;
+  options[numoptions++]=argv[0];
+  for (arg=2; arg<argc && numsources<MAXFILES && numoptions<MAXFILES; arg++) {
+    if (argv[arg][0]=='-') {
+      options[numoptions++]=argv[arg];
+    } else {
+      sources[numsources].name=argv[arg];
+      if ((sources[numsources].text=readfile(argv[arg],&sources[numsources].length))==NULL) {
+        printf("cannot read \"%s\"\n",argv[arg]);
+        return 1;
+      } /* if */
+      numsources++;
+    } /* if */
+  } /* for */
+  options[numoptions]=NULL;
+
+  /* first ask for the size, then compile again into a buffer that fits */
+  size=0;
+  retcode=pc_compilememory(numoptions,options,sources,numsources,resolver,NULL,NULL,&size);
+  if (retcode==-1) {
+    if ((image=(unsigned char*)malloc(size))==NULL)
+      return 1;
+    retcode=pc_compilememory(numoptions,options,sources,numsources,resolver,NULL,image,&size);
+    if (retcode==0 && (fp=fopen(argv[1],"wb"))!=NULL) {
+      fwrite(image,1,size,fp);
+      fclose(fp);
+    } /* if */
+    free(image);
+  } /* if */
+  while (numfiles>0)
+    free(filetext[--numfiles]);
+  return retcode;
+}
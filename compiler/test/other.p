@@ -0,0 +1,6 @@
+#include <lib>
+
+main()
+{
+    print("other\n");
+}
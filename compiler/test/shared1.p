@@ -0,0 +1,9 @@
+/* first of two source files that share "static" symbols */
+#include <lib>
+
+static counter = 3;
+
+static twice(value)
+{
+    return value * 2;
+}
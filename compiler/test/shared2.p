@@ -0,0 +1,5 @@
+/* second source file, uses the static symbols of shared1.p */
+main()
+{
+    printf("%d\n", twice(counter) + LIMIT);
+}
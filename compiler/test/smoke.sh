@@ -0,0 +1,154 @@
+#!/bin/sh
+# Smoke test for the build modes of the Pawn compiler: every mode must give
+# the same output file as a plain compile of the same sources.
+#
+# Usage: smoke.sh <gf-pawncc> <pawnc-memtest> <directory with the test sources>
+
+PAWNCC=$1
+MEMTEST=$2
+SOURCES=$3
+WORK=${TMPDIR:-/tmp}/pawnsmoke.$$
+SERVER=
+
+fail() {
+  echo "FAILED: $1"
+  [ -n "$SERVER" ] && kill $SERVER 2>/dev/null
+  exit 1
+}
+
+# same <file> <reference> <test name>
+same() {
+  cmp -s "$1" "$2" || fail "$3: $1 differs from $2"
+  echo "ok: $3"
+}
+
+rm -rf "$WORK"
+mkdir -p "$WORK" || fail "cannot create $WORK"
+cp -R "$SOURCES"/. "$WORK" || fail "cannot copy the test sources"
+cd "$WORK" || exit 1
+trap 'cd /; rm -rf "$WORK"' 0
+
+OPTS="-iinclude -d0"
+
+# reference compiles
+$PAWNCC main.p $OPTS -oref.amx >ref.log 2>&1 || fail "plain compile of main.p"
+$PAWNCC other.p $OPTS -oref2.amx >ref2.log 2>&1 || fail "plain compile of other.p"
+$PAWNCC main.p $OPTS -pprefix.inc -orefp.amx >refp.log 2>&1 || fail "plain compile with prefix"
+
+# several source files are compiled as one file; "static" symbols in the
+# first file are visible in the second file
+cat shared1.p shared2.p >joined.p
+$PAWNCC joined.p $OPTS -ojoined.amx >/dev/null 2>&1 || fail "plain compile of joined.p"
+$PAWNCC shared1.p shared2.p $OPTS -oshared.amx >/dev/null 2>&1 || fail "two source files"
+same shared.amx joined.amx "two source files"
+# a message for the second source file names that file
+printf 'public unused()\n{\n    new a;\n}\n' >unused.p
+$PAWNCC main.p unused.p $OPTS -ounused.amx >unused.log 2>&1 || fail "two source files with a warning"
+grep -q '^unused.p(3) : warning 203' unused.log || fail "two source files: the warning does not name unused.p"
+echo "ok: two source files (file name in a warning)"
+
+# -E: the expanded source compiles to the same output (the "#file" lines in
+# the list file hold unquoted names, so these are removed)
+$PAWNCC main.p $OPTS -E -oexpanded >/dev/null 2>&1 || fail "-E"
+grep -v '^#file' expanded.lst >expanded.p
+$PAWNCC expanded.p -d0 -oexp.amx >/dev/null 2>&1 || fail "compile of the -E output"
+same exp.amx ref.amx "-E"
+
+# -P: create the precompiled prefix, then use it
+$PAWNCC main.p $OPTS -pprefix.inc -Pprefix.pch -opch1.amx >/dev/null 2>&1 || fail "-P (create)"
+[ -f prefix.pch ] || fail "-P did not create prefix.pch"
+$PAWNCC main.p $OPTS -pprefix.inc -Pprefix.pch -opch2.amx >/dev/null 2>&1 || fail "-P (use)"
+same pch1.amx refp.amx "-P (create)"
+same pch2.amx refp.amx "-P (use)"
+# a truncated snapshot is rebuilt from the prefix file
+head -c $(($(wc -c <prefix.pch)-8)) prefix.pch >short.pch
+$PAWNCC main.p $OPTS -pprefix.inc -Pshort.pch -opch3.amx >/dev/null 2>&1 || fail "-P (truncated snapshot)"
+same pch3.amx refp.amx "-P (truncated snapshot)"
+
+# -M: the dependency file lists the include file, and nothing that is missing
+$PAWNCC main.p $OPTS -Mdeps.d -odeps.amx >/dev/null 2>&1 || fail "-M"
+same deps.amx ref.amx "-M"
+grep -q "include/lib.inc" deps.d || fail "-M: include/lib.inc is not in deps.d"
+if command -v make >/dev/null 2>&1; then
+  printf 'deps.amx:\n\t@true\ninclude deps.d\n' >deps.mk
+  make -s -f deps.mk >/dev/null 2>&1 || fail "-M: make cannot read deps.d"
+fi
+
+# -K: the first compile fills the cache, the second one is a hit
+$PAWNCC main.p $OPTS -Kcache -ocache1.amx >/dev/null 2>&1 || fail "-K (store)"
+ls cache/*.out >/dev/null 2>&1 || fail "-K did not store the output file"
+$PAWNCC main.p $OPTS -Kcache -ocache2.amx >/dev/null 2>&1 || fail "-K (fetch)"
+same cache1.amx ref.amx "-K (store)"
+same cache2.amx ref.amx "-K (fetch)"
+# a change in an included file is a miss
+cp include/lib.inc lib.inc.org
+sed 's/LIMIT = 10/LIMIT = 12/' lib.inc.org >include/lib.inc
+$PAWNCC main.p $OPTS -ocacheref.amx >/dev/null 2>&1 || fail "plain compile with the changed lib.inc"
+$PAWNCC main.p $OPTS -Kcache -ocache3.amx >/dev/null 2>&1 || fail "-K (changed include file)"
+cp lib.inc.org include/lib.inc
+cmp -s cacheref.amx ref.amx && fail "-K: the change in lib.inc does not change the output"
+same cache3.amx cacheref.amx "-K (changed include file)"
+
+# -B: a manifest with two jobs and a failing job
+printf '# smoke test\nmain.p -obatch1.amx\nmissing.p -obatch3.amx\n\nother.p -obatch2.amx\n' >jobs.txt
+$PAWNCC -Bjobs.txt $OPTS >batch.log 2>&1 && fail "-B: a failing job is not reported"
+same batch1.amx ref.amx "-B (job 1)"
+same batch2.amx ref2.amx "-B (job 3, after a failing job)"
+
+# -j: every source file is a separate job
+rm -f main.amx other.amx
+$PAWNCC -j2 main.p other.p $OPTS >jobs.log 2>&1 || fail "-j"
+same main.amx ref.amx "-j (main.p)"
+same other.amx ref2.amx "-j (other.p)"
+$PAWNCC -j2 main.p other.p $OPTS -oboth.amx >jobs.log 2>&1 && fail "-j: -o is accepted for two source files"
+echo "ok: -j (refuses -o for two source files)"
+
+# -z without a server compiles locally; -Z/-z with a server
+$PAWNCC -zsmoke.sock main.p $OPTS -olocal.amx >/dev/null 2>&1 || fail "-z without a server"
+same local.amx ref.amx "-z (no server)"
+if $PAWNCC 2>&1 | grep -q -- "-Z<name>"; then
+  # the server must not remove a file that is not a socket
+  echo "keep" >victim.txt
+  $PAWNCC -Zvictim.txt >/dev/null 2>&1 && fail "-Z on a regular file"
+  grep -q keep victim.txt || fail "-Z removed a regular file"
+  echo "ok: -Z (regular file)"
+  $PAWNCC -Zsmoke.sock >server.log 2>&1 &
+  SERVER=$!
+  count=0
+  while [ ! -S smoke.sock ] && [ $count -lt 50 ]; do
+    sleep 0.1
+    count=$((count+1))
+  done
+  [ -S smoke.sock ] || fail "-Z: the server did not start"
+  $PAWNCC -zsmoke.sock main.p $OPTS -oserver1.amx >/dev/null 2>&1 || fail "-z (first request)"
+  $PAWNCC -zsmoke.sock main.p $OPTS -oserver2.amx >/dev/null 2>&1 || fail "-z (second request)"
+  # edit an include file (without changing its size) between two requests
+  printf '#include "edit.inc"\nmain()\n    return VALUE;\n' >edit.p
+  printf 'const VALUE = 11;\n' >edit.inc
+  $PAWNCC -zsmoke.sock edit.p $OPTS -oedit1.amx >/dev/null 2>&1 || fail "-z (before the edit)"
+  printf 'const VALUE = 22;\n' >edit.inc
+  $PAWNCC -zsmoke.sock edit.p $OPTS -oedit2.amx >/dev/null 2>&1 || fail "-z (after the edit)"
+  $PAWNCC edit.p $OPTS -oeditref.amx >/dev/null 2>&1 || fail "plain compile of edit.p"
+  kill $SERVER 2>/dev/null
+  wait $SERVER 2>/dev/null
+  SERVER=
+  same server1.amx ref.amx "-Z/-z (first request)"
+  same server2.amx ref.amx "-Z/-z (second request)"
+  same edit2.amx editref.amx "-Z/-z (edited include file)"
+fi
+
+# pc_compilememory() in the library
+$MEMTEST memory.amx $OPTS main.p >memory.log 2>&1 || fail "pc_compilememory()"
+same memory.amx ref.amx "pc_compilememory()"
+$MEMTEST memshared.amx $OPTS shared1.p shared2.p >memory.log 2>&1 || fail "pc_compilememory() with two sources"
+same memshared.amx joined.amx "pc_compilememory() with two sources"
+
+# a source file and an include file without a '\n' at the end of the last line
+printf '#include "nonl.inc"\nmain()\n{\n    return NONL;\n}' >nonl.p
+printf 'const NONL = 1;' >nonl.inc
+$PAWNCC nonl.p $OPTS -ononl.amx >/dev/null 2>&1 || fail "compile of nonl.p"
+$MEMTEST memnonl.amx $OPTS nonl.p >memory.log 2>&1 || fail "pc_compilememory() without a final newline"
+same memnonl.amx nonl.amx "pc_compilememory() without a final newline"
+
+echo "all tests passed"
+exit 0